@@ -0,0 +1,154 @@
+#pragma once
+
+#include <inttypes.h>
+#include <string.h>
+#include <stdio.h>
+#include <endian.h>
+
+// This is the format written by --binary and a small reference reader for it,
+// the reader is header-only so that other tools can just include this file
+//
+// The stream starts with a BinaryFrameHeader and then either:
+//   frames: numLeds * 3 bytes (red, green, blue) for every tick, or when the
+//           header has BINARY_FLAG_TICKS (the --every, --from-tick style
+//           filters skipped some) the 4 byte tick before each frame
+//   events: a BinaryLedEvent for each led that changed color on a tick, all of
+//           the leds are sent on the first tick and the stream ends with an
+//           event on led BINARY_EVENT_END whose tick is the total tick count
+//
+// All multi-byte fields are little endian, the writer and reader convert them
+// from and to the host order
+
+#define BINARY_FRAMES_MAGIC "VTXF"
+#define BINARY_FRAMES_VERSION 1
+
+// the frames aren't every tick so each one starts with its tick
+#define BINARY_FLAG_TICKS 0x1
+
+// the led index of the event that marks the end of an events stream
+#define BINARY_EVENT_END 0xFF
+
+enum BinaryFrameFormat : uint8_t
+{
+  BINARY_FORMAT_FRAMES = 0,
+  BINARY_FORMAT_EVENTS = 1,
+};
+
+#pragma pack(push, 1)
+struct BinaryFrameHeader
+{
+  char magic[4];
+  uint8_t version;
+  uint8_t format;
+  uint16_t numLeds;
+  uint32_t tickrate;
+  uint32_t flags;
+};
+
+struct BinaryLedEvent
+{
+  uint32_t tick;
+  uint8_t led;
+  uint8_t red;
+  uint8_t green;
+  uint8_t blue;
+};
+#pragma pack(pop)
+
+class BinaryFrameReader
+{
+public:
+  BinaryFrameReader() : m_file(nullptr), m_header(), m_tick(0), m_frameTick(0), m_haveEvent(false), m_event(), m_leds() {}
+
+  // read the header from an open stream, the stream is not closed by the reader
+  bool open(FILE *file)
+  {
+    m_file = file;
+    m_tick = 0;
+    m_frameTick = 0;
+    m_haveEvent = false;
+    memset(m_leds, 0, sizeof(m_leds));
+    if (fread(&m_header, sizeof(m_header), 1, m_file) != 1) {
+      return false;
+    }
+    if (memcmp(m_header.magic, BINARY_FRAMES_MAGIC, sizeof(m_header.magic)) != 0) {
+      return false;
+    }
+    m_header.numLeds = le16toh(m_header.numLeds);
+    m_header.tickrate = le32toh(m_header.tickrate);
+    m_header.flags = le32toh(m_header.flags);
+    if (m_header.version != BINARY_FRAMES_VERSION || m_header.numLeds > BINARY_EVENT_END) {
+      return false;
+    }
+    return true;
+  }
+
+  const BinaryFrameHeader &header() const { return m_header; }
+  uint32_t numLeds() const { return m_header.numLeds; }
+  // the tick of the frame that readFrame returned last
+  uint32_t frameTick() const { return m_frameTick; }
+
+  // read the next frame into rgb which must hold numLeds * 3 bytes, this works
+  // for both formats, returns false at the end of the stream
+  bool readFrame(uint8_t *rgb)
+  {
+    if (m_header.format == BINARY_FORMAT_FRAMES) {
+      if (m_header.flags & BINARY_FLAG_TICKS) {
+        uint32_t tick = 0;
+        if (fread(&tick, sizeof(tick), 1, m_file) != 1) {
+          return false;
+        }
+        m_tick = le32toh(tick);
+      }
+      if (fread(rgb, 3, m_header.numLeds, m_file) != m_header.numLeds) {
+        return false;
+      }
+      m_frameTick = m_tick++;
+      return true;
+    }
+    // apply every event that happened on this tick
+    while (true) {
+      if (!m_haveEvent && !readEvent(m_event)) {
+        return false;
+      }
+      m_haveEvent = true;
+      if (m_event.tick > m_tick) {
+        break;
+      }
+      if (m_event.led == BINARY_EVENT_END) {
+        return false;
+      }
+      if (m_event.led < m_header.numLeds) {
+        m_leds[(m_event.led * 3) + 0] = m_event.red;
+        m_leds[(m_event.led * 3) + 1] = m_event.green;
+        m_leds[(m_event.led * 3) + 2] = m_event.blue;
+      }
+      m_haveEvent = false;
+    }
+    memcpy(rgb, m_leds, m_header.numLeds * 3);
+    m_frameTick = m_tick++;
+    return true;
+  }
+
+  // read the next raw event of an events stream
+  bool readEvent(BinaryLedEvent &event)
+  {
+    if (fread(&event, sizeof(event), 1, m_file) != 1) {
+      return false;
+    }
+    event.tick = le32toh(event.tick);
+    return true;
+  }
+
+private:
+  FILE *m_file;
+  BinaryFrameHeader m_header;
+  // the tick the next frame is expected on and the last one read
+  uint32_t m_tick;
+  uint32_t m_frameTick;
+  // the next event if it was read ahead of its tick
+  bool m_haveEvent;
+  BinaryLedEvent m_event;
+  // the current state of all leds in an events stream
+  uint8_t m_leds[BINARY_EVENT_END * 3];
+};
@@ -0,0 +1,227 @@
+#include "ColorPalette.h"
+
+#include "Colors/ColorTypes.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// the pieces of a single palette led, unlike the 24bit cells these don't reset
+// before the [ because every cell already ends with a reset
+#define PALETTE_256_PREFIX "[\x1B[48;5;"
+#define PALETTE_16_PREFIX "[\x1B["
+#define PALETTE_SUFFIX "m  \x1B[0m]"
+
+// the index of max_colors in the numbers section of a compiled terminfo entry
+#define TERMINFO_MAX_COLORS 13
+#define TERMINFO_MAGIC 0432
+#define TERMINFO_MAGIC_32BIT 01036
+
+// the levels of each channel in the 6x6x6 cube of the 256 color palette
+static const uint8_t cubeLevels[6] = { 0, 95, 135, 175, 215, 255 };
+
+// the usual xterm colors for the 16 color palette
+static const uint8_t basicColors[16][3] = {
+  { 0, 0, 0 },       { 205, 0, 0 },     { 0, 205, 0 },     { 205, 205, 0 },
+  { 0, 0, 238 },     { 205, 0, 205 },   { 0, 205, 205 },   { 229, 229, 229 },
+  { 127, 127, 127 }, { 255, 0, 0 },     { 0, 255, 0 },     { 255, 255, 0 },
+  { 92, 92, 255 },   { 255, 0, 255 },   { 0, 255, 255 },   { 255, 255, 255 },
+};
+
+static uint32_t distance(int r1, int g1, int b1, int r2, int g2, int b2)
+{
+  return ((r1 - r2) * (r1 - r2)) + ((g1 - g2) * (g1 - g2)) + ((b1 - b2) * (b1 - b2));
+}
+
+ColorPalette::ColorPalette() :
+  m_mode(MODE_TRUECOLOR),
+  m_table(),
+  m_cells(),
+  m_cellLens()
+{
+}
+
+ColorPalette::Mode ColorPalette::detect()
+{
+  if (!isatty(STDOUT_FILENO)) {
+    // output that is piped or saved keeps the original 24bit colors so it
+    // doesn't change with the terminal it was made in
+    return MODE_TRUECOLOR;
+  }
+  const char *colorterm = getenv("COLORTERM");
+  if (colorterm && (strcmp(colorterm, "truecolor") == 0 || strcmp(colorterm, "24bit") == 0)) {
+    return MODE_TRUECOLOR;
+  }
+  const char *term = getenv("TERM");
+  if (!term || !*term) {
+    // nothing to go on, keep the original 24bit output
+    return MODE_TRUECOLOR;
+  }
+  int colors = terminfoColors(term);
+  if (colors < 0) {
+    // no terminfo entry, the name is usually enough
+    if (strstr(term, "256color")) {
+      return MODE_256;
+    }
+    if (strstr(term, "16color") || strcmp(term, "linux") == 0 || strcmp(term, "ansi") == 0) {
+      return MODE_16;
+    }
+    return MODE_TRUECOLOR;
+  }
+  if (colors >= (1 << 24)) {
+    return MODE_TRUECOLOR;
+  }
+  if (colors >= 256) {
+    return MODE_256;
+  }
+  return MODE_16;
+}
+
+bool ColorPalette::parse(const char *name, Mode &out)
+{
+  if (strcmp(name, "auto") == 0) {
+    out = detect();
+  } else if (strcmp(name, "truecolor") == 0 || strcmp(name, "24bit") == 0) {
+    out = MODE_TRUECOLOR;
+  } else if (strcmp(name, "256") == 0) {
+    out = MODE_256;
+  } else if (strcmp(name, "16") == 0) {
+    out = MODE_16;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void ColorPalette::init(Mode mode)
+{
+  m_mode = mode;
+  if (mode == MODE_TRUECOLOR) {
+    return;
+  }
+  // every palette entry gets a prebuilt cell
+  uint32_t numEntries = (mode == MODE_256) ? 256 : 16;
+  for (uint32_t i = 0; i < numEntries; ++i) {
+    int len;
+    if (mode == MODE_256) {
+      len = snprintf(m_cells[i], maxCellBytes, PALETTE_256_PREFIX "%u" PALETTE_SUFFIX, i);
+    } else {
+      // 40-47 for the normal colors and 100-107 for the bright ones
+      uint32_t code = (i < 8) ? (40 + i) : (100 + (i - 8));
+      len = snprintf(m_cells[i], maxCellBytes, PALETTE_16_PREFIX "%u" PALETTE_SUFFIX, code);
+    }
+    m_cellLens[i] = (uint8_t)len;
+  }
+  // then the middle of every 5 bit bucket is matched to the closest entry
+  for (uint32_t i = 0; i < sizeof(m_table); ++i) {
+    uint8_t r = (uint8_t)((((i >> 10) & 0x1F) << 3) | 4);
+    uint8_t g = (uint8_t)((((i >> 5) & 0x1F) << 3) | 4);
+    uint8_t b = (uint8_t)(((i & 0x1F) << 3) | 4);
+    m_table[i] = (mode == MODE_256) ? nearest256(r, g, b) : nearest16(r, g, b);
+  }
+}
+
+uint8_t ColorPalette::lookup(const RGBColor &col) const
+{
+  return m_table[((col.red >> 3) << 10) | ((col.green >> 3) << 5) | (col.blue >> 3)];
+}
+
+uint8_t ColorPalette::nearest256(uint8_t r, uint8_t g, uint8_t b)
+{
+  // the closest level of the cube is found per channel
+  uint8_t idx[3];
+  uint8_t chans[3] = { r, g, b };
+  for (uint32_t c = 0; c < 3; ++c) {
+    uint8_t best = 0;
+    for (uint8_t l = 1; l < 6; ++l) {
+      if (abs(chans[c] - cubeLevels[l]) < abs(chans[c] - cubeLevels[best])) {
+        best = l;
+      }
+    }
+    idx[c] = best;
+  }
+  uint32_t cubeDist = distance(r, g, b, cubeLevels[idx[0]], cubeLevels[idx[1]], cubeLevels[idx[2]]);
+  // then the closest of the 24 grays (8, 18 ... 238) to the average
+  int avg = (r + g + b) / 3;
+  int gray = (avg < 8) ? 0 : ((avg - 8 + 5) / 10);
+  if (gray > 23) {
+    gray = 23;
+  }
+  int level = 8 + (gray * 10);
+  uint32_t grayDist = distance(r, g, b, level, level, level);
+  if (grayDist < cubeDist) {
+    return (uint8_t)(232 + gray);
+  }
+  return (uint8_t)(16 + (36 * idx[0]) + (6 * idx[1]) + idx[2]);
+}
+
+uint8_t ColorPalette::nearest16(uint8_t r, uint8_t g, uint8_t b)
+{
+  uint8_t best = 0;
+  uint32_t bestDist = UINT32_MAX;
+  for (uint8_t i = 0; i < 16; ++i) {
+    uint32_t dist = distance(r, g, b, basicColors[i][0], basicColors[i][1], basicColors[i][2]);
+    if (dist < bestDist) {
+      bestDist = dist;
+      best = i;
+    }
+  }
+  return best;
+}
+
+int ColorPalette::terminfoColors(const char *term)
+{
+  // the same places ncurses looks, terminals are stored under their first
+  // letter or under its hex code on some systems
+  const char *dirs[] = { getenv("TERMINFO"), nullptr, "/etc/terminfo", "/lib/terminfo", "/usr/share/terminfo" };
+  char home[512] = "";
+  if (getenv("HOME")) {
+    snprintf(home, sizeof(home), "%s/.terminfo", getenv("HOME"));
+    dirs[1] = home;
+  }
+  if (strchr(term, '/')) {
+    return -1;
+  }
+  FILE *f = nullptr;
+  for (uint32_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]) && !f; ++i) {
+    if (!dirs[i]) {
+      continue;
+    }
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%c/%s", dirs[i], term[0], term);
+    f = fopen(path, "rb");
+    if (!f) {
+      snprintf(path, sizeof(path), "%s/%02x/%s", dirs[i], (uint8_t)term[0], term);
+      f = fopen(path, "rb");
+    }
+  }
+  if (!f) {
+    return -1;
+  }
+  // header: magic, names size, booleans, numbers, strings, string table size
+  uint8_t header[12];
+  int colors = -1;
+  if (fread(header, 1, sizeof(header), f) == sizeof(header)) {
+    uint16_t magic = header[0] | (header[1] << 8);
+    uint16_t namesSize = header[2] | (header[3] << 8);
+    uint16_t numBools = header[4] | (header[5] << 8);
+    uint16_t numNums = header[6] | (header[7] << 8);
+    uint32_t numSize = (magic == TERMINFO_MAGIC_32BIT) ? 4 : 2;
+    // the numbers start on an even byte after the names and booleans
+    uint32_t offset = sizeof(header) + namesSize + numBools;
+    offset += offset & 1;
+    offset += TERMINFO_MAX_COLORS * numSize;
+    uint8_t num[4] = { 0 };
+    if ((magic == TERMINFO_MAGIC || magic == TERMINFO_MAGIC_32BIT) && numNums > TERMINFO_MAX_COLORS &&
+        fseek(f, offset, SEEK_SET) == 0 && fread(num, 1, numSize, f) == numSize) {
+      if (numSize == 4) {
+        colors = (int32_t)(num[0] | (num[1] << 8) | (num[2] << 16) | ((uint32_t)num[3] << 24));
+      } else {
+        colors = (int16_t)(num[0] | (num[1] << 8));
+      }
+    }
+  }
+  fclose(f);
+  return colors;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+class RGBColor;
+
+// This maps led colors to the 256 or 16 color palettes for terminals that can't
+// do (or are slow at) 24bit color. Every color is quantized to 5 bits per
+// channel and looked up in a table that is built once, then the led is printed
+// with a prebuilt cell for that palette entry
+
+class ColorPalette
+{
+public:
+  ColorPalette();
+
+  enum Mode {
+    MODE_TRUECOLOR,
+    MODE_256,
+    MODE_16,
+  };
+
+  // work out the best mode from $COLORTERM and the terminfo entry for $TERM,
+  // or truecolor when stdout isn't a terminal
+  static Mode detect();
+  // parse a mode name (truecolor, 256, 16 or auto), false if unknown
+  static bool parse(const char *name, Mode &out);
+
+  // build the lookup table for a palette mode
+  void init(Mode mode);
+
+  Mode mode() const { return m_mode; }
+
+  // the [  ] cell for an led in the palette
+  const char *cell(const RGBColor &col) const { return m_cells[lookup(col)]; }
+  size_t cellLen(const RGBColor &col) const { return m_cellLens[lookup(col)]; }
+
+  // the largest a cell can be
+  static const size_t maxCellBytes = 24;
+
+private:
+  uint8_t lookup(const RGBColor &col) const;
+  // the palette index closest to a color
+  static uint8_t nearest256(uint8_t r, uint8_t g, uint8_t b);
+  static uint8_t nearest16(uint8_t r, uint8_t g, uint8_t b);
+  // the max_colors of the terminfo entry for a terminal, or -1
+  static int terminfoColors(const char *term);
+
+  Mode m_mode;
+  // palette index for every 15bit color
+  uint8_t m_table[32 * 32 * 32];
+  char m_cells[256][maxCellBytes];
+  uint8_t m_cellLens[256];
+};
@@ -0,0 +1,160 @@
+#include "CommandLogWriter.h"
+#include "OutputWriter.h"
+#include "TickProfiler.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// how long something can sit in the buffer before the tick loop writes it
+#define LOG_FLUSH_INTERVAL (1000 * 1000000ull)
+
+// the logs that are open, there's only ever a couple of them
+#define MAX_LOGS 4
+static CommandLogWriter *volatile g_logs[MAX_LOGS] = { nullptr };
+
+// the signals that end the process that are worth saving the log for
+static const int g_fatalSignals[] = { SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+#define NUM_FATAL_SIGNALS (sizeof(g_fatalSignals) / sizeof(g_fatalSignals[0]))
+
+CommandLogWriter::CommandLogWriter() :
+  m_fd(-1),
+  m_buf(),
+  m_len(0),
+  m_written(0),
+  m_lastFlush(0)
+{
+}
+
+CommandLogWriter::~CommandLogWriter()
+{
+  close();
+}
+
+bool CommandLogWriter::open(const char *filename)
+{
+  close();
+  m_fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (m_fd < 0) {
+    return false;
+  }
+  m_len = 0;
+  m_written = 0;
+  m_lastFlush = TickProfiler::now();
+  for (uint32_t i = 0; i < MAX_LOGS; ++i) {
+    if (!g_logs[i]) {
+      g_logs[i] = this;
+      break;
+    }
+  }
+  return true;
+}
+
+void CommandLogWriter::close()
+{
+  if (m_fd < 0) {
+    return;
+  }
+  for (uint32_t i = 0; i < MAX_LOGS; ++i) {
+    if (g_logs[i] == this) {
+      g_logs[i] = nullptr;
+    }
+  }
+  flush();
+  ::close(m_fd);
+  m_fd = -1;
+}
+
+void CommandLogWriter::write(const char *data, size_t len)
+{
+  if (m_fd < 0) {
+    return;
+  }
+  while (len) {
+    if (m_len == sizeof(m_buf)) {
+      flush();
+    }
+    size_t amt = sizeof(m_buf) - m_len;
+    if (amt > len) {
+      amt = len;
+    }
+    memcpy(m_buf + m_len, data, amt);
+    m_len = m_len + amt;
+    data += amt;
+    len -= amt;
+  }
+}
+
+void CommandLogWriter::poll(uint64_t now)
+{
+  if (m_len && now - m_lastFlush >= LOG_FLUSH_INTERVAL) {
+    flush();
+  }
+}
+
+void CommandLogWriter::flush()
+{
+  m_lastFlush = TickProfiler::now();
+  // the progress is kept as it goes so a signal in the middle of this only
+  // writes what's left
+  size_t len = m_len;
+  while (m_written < len) {
+    ssize_t amt = ::write(m_fd, m_buf + m_written, len - m_written);
+    if (amt < 0 && errno == EINTR) {
+      continue;
+    }
+    if (amt <= 0) {
+      break;
+    }
+    m_written = m_written + amt;
+  }
+  // in this order so there's never more written than held
+  m_len = 0;
+  m_written = 0;
+}
+
+void CommandLogWriter::handleFatalSignals()
+{
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onFatalSignal;
+  sigemptyset(&sa.sa_mask);
+  // back to the default as soon as it goes off so the raise below ends it
+  sa.sa_flags = SA_RESETHAND;
+  for (uint32_t i = 0; i < NUM_FATAL_SIGNALS; ++i) {
+    sigaction(g_fatalSignals[i], &sa, nullptr);
+  }
+}
+
+void CommandLogWriter::flushAll()
+{
+  for (uint32_t i = 0; i < MAX_LOGS; ++i) {
+    if (g_logs[i]) {
+      g_logs[i]->flush();
+    }
+  }
+}
+
+void CommandLogWriter::onFatalSignal(int sig)
+{
+  // only write() is used which is safe in a handler, then the signal is
+  // sent again to do whatever it would have done
+  for (uint32_t i = 0; i < MAX_LOGS; ++i) {
+    CommandLogWriter *log = g_logs[i];
+    if (log && log->m_fd >= 0 && log->m_len > log->m_written) {
+      size_t written = log->m_written;
+      ssize_t amt = ::write(log->m_fd, log->m_buf + written, log->m_len - written);
+      if (amt > 0) {
+        log->m_written = written + amt;
+      }
+    }
+  }
+  // a kill still gets every frame that was made, after a crash the ring
+  // can't be trusted
+  if (sig == SIGINT || sig == SIGTERM) {
+    OutputWriter::drainAll();
+  }
+  raise(sig);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+// This streams the recorded input commands to a file as they come in so a
+// long session never holds its whole log in memory. The writes are buffered
+// and flushed when the buffer fills, once a second from the tick loop, and
+// from the handlers of the fatal signals so a crash or kill still leaves the
+// full repro behind (everything but a SIGKILL). The same handlers write out
+// the rings of the OutputWriters on a SIGINT or SIGTERM
+
+// how much is held before it's written out
+#define LOG_BUFFER_SIZE (16 * 1024)
+
+class CommandLogWriter
+{
+public:
+  CommandLogWriter();
+  ~CommandLogWriter();
+
+  bool open(const char *filename);
+  void close();
+  bool isOpen() const { return m_fd >= 0; }
+
+  void write(const char *data, size_t len);
+  // write out the buffer if it's been held for long enough
+  void poll(uint64_t now);
+  void flush();
+
+  // install the handlers that flush every open log (and output ring) on a
+  // fatal signal
+  static void handleFatalSignals();
+  // flush every open log
+  static void flushAll();
+
+private:
+  static void onFatalSignal(int sig);
+
+  int m_fd;
+  char m_buf[LOG_BUFFER_SIZE];
+  // only moved after the data is in the buffer so a signal handler never
+  // writes half of an append
+  volatile size_t m_len;
+  // how much of the buffer a flush has already written
+  volatile size_t m_written;
+  uint64_t m_lastFlush;
+};
@@ -0,0 +1,169 @@
+#include "EventReactor.h"
+
+#include <sys/timerfd.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+// the timer is registered with a null source so it's told apart from the rest
+#define TIMER_SOURCE nullptr
+
+EventReactor::EventReactor() :
+  m_epollFd(-1),
+  m_timerFd(-1),
+  m_expirations(0),
+  m_sources()
+{
+  for (uint32_t i = 0; i < MAX_SOURCES; ++i) {
+    m_sources[i].fd = -1;
+  }
+}
+
+EventReactor::~EventReactor()
+{
+  cleanup();
+}
+
+bool EventReactor::init()
+{
+  cleanup();
+  m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (m_epollFd < 0) {
+    return false;
+  }
+  m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (m_timerFd < 0) {
+    cleanup();
+    return false;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.ptr = TIMER_SOURCE;
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_timerFd, &ev) != 0) {
+    cleanup();
+    return false;
+  }
+  return true;
+}
+
+void EventReactor::cleanup()
+{
+  if (m_timerFd >= 0) {
+    close(m_timerFd);
+    m_timerFd = -1;
+  }
+  if (m_epollFd >= 0) {
+    close(m_epollFd);
+    m_epollFd = -1;
+  }
+  for (uint32_t i = 0; i < MAX_SOURCES; ++i) {
+    m_sources[i].fd = -1;
+  }
+  m_expirations = 0;
+}
+
+bool EventReactor::add(int fd, uint32_t events, event_fn_t handler, void *arg)
+{
+  Source *source = findSource(-1);
+  if (!source || fd < 0) {
+    return false;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.ptr = source;
+  if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+    return false;
+  }
+  source->fd = fd;
+  source->handler = handler;
+  source->arg = arg;
+  return true;
+}
+
+bool EventReactor::modify(int fd, uint32_t events)
+{
+  Source *source = findSource(fd);
+  if (!source) {
+    return false;
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.ptr = source;
+  return epoll_ctl(m_epollFd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventReactor::remove(int fd)
+{
+  Source *source = findSource(fd);
+  if (!source) {
+    return;
+  }
+  epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  source->fd = -1;
+}
+
+bool EventReactor::setDeadline(uint64_t deadline, uint64_t interval)
+{
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  spec.it_value.tv_sec = deadline / 1000000000;
+  spec.it_value.tv_nsec = deadline % 1000000000;
+  spec.it_interval.tv_sec = interval / 1000000000;
+  spec.it_interval.tv_nsec = interval % 1000000000;
+  // a deadline in the past goes off right away, an all zero value disarms
+  m_expirations = 0;
+  return timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) == 0;
+}
+
+uint64_t EventReactor::takeExpirations()
+{
+  uint64_t expirations = m_expirations;
+  m_expirations = 0;
+  return expirations;
+}
+
+int EventReactor::poll(int timeoutMs)
+{
+  struct epoll_event events[MAX_SOURCES + 1];
+  int count = epoll_wait(m_epollFd, events, MAX_SOURCES + 1, timeoutMs);
+  if (count < 0) {
+    // interrupted by a signal like SIGWINCH
+    return 0;
+  }
+  for (int i = 0; i < count; ++i) {
+    Source *source = (Source *)events[i].data.ptr;
+    if (source == TIMER_SOURCE) {
+      uint64_t expirations = 0;
+      if (read(m_timerFd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+        m_expirations += expirations;
+      }
+      continue;
+    }
+    // a handler may have removed this source while handling an earlier event
+    if (source->fd >= 0) {
+      source->handler(source->arg, source->fd, events[i].events);
+    }
+  }
+  return count;
+}
+
+uint64_t EventReactor::now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+EventReactor::Source *EventReactor::findSource(int fd)
+{
+  for (uint32_t i = 0; i < MAX_SOURCES; ++i) {
+    if (m_sources[i].fd == fd) {
+      return m_sources + i;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+// This is the event loop of the linux framework. Every descriptor the
+// framework waits on (stdin, the control fifo, the IR socket, a serial
+// device) is registered here with a handler and the tick deadline is a
+// timerfd, so one epoll_wait sleeps until whichever of them happens first
+// instead of the engine being ticked just to check for input
+
+class EventReactor
+{
+public:
+  EventReactor();
+  ~EventReactor();
+
+  // called with the fd and the epoll events that are ready on it
+  typedef void (*event_fn_t)(void *arg, int fd, uint32_t events);
+
+  bool init();
+  void cleanup();
+
+  // start or stop waiting on a descriptor
+  bool add(int fd, uint32_t events, event_fn_t handler, void *arg);
+  bool modify(int fd, uint32_t events);
+  void remove(int fd);
+
+  // arm the timer for an absolute CLOCK_MONOTONIC time in nanoseconds and
+  // then every interval after that (if there is one), or disarm it with 0
+  bool setDeadline(uint64_t deadline, uint64_t interval);
+  // how many times the timer went off since the last call, more than one
+  // means deadlines were missed
+  uint64_t takeExpirations();
+
+  // wait until an event or the deadline and run the handlers, a timeout of
+  // -1 waits forever. Returns the number of events that were handled
+  int poll(int timeoutMs);
+
+  // the current CLOCK_MONOTONIC time in nanoseconds
+  static uint64_t now();
+
+private:
+  // the most descriptors that can be registered at once
+  static const uint32_t MAX_SOURCES = 8;
+
+  struct Source
+  {
+    int fd;
+    event_fn_t handler;
+    void *arg;
+  };
+
+  Source *findSource(int fd);
+
+  int m_epollFd;
+  int m_timerFd;
+  uint64_t m_expirations;
+  Source m_sources[MAX_SOURCES];
+};
@@ -0,0 +1,109 @@
+#include "FrameBuffer.h"
+
+#include "Colors/ColorTypes.h"
+
+#include <stdlib.h>
+
+// how many frames to start with when the length of the run isn't known
+#define DEFAULT_CAPACITY 4096
+
+FrameBuffer::FrameBuffer() :
+  m_numLeds(0),
+  m_numFrames(0),
+  m_capacity(0),
+  m_red(nullptr),
+  m_green(nullptr),
+  m_blue(nullptr),
+  m_ticks(nullptr)
+{
+}
+
+FrameBuffer::~FrameBuffer()
+{
+  cleanup();
+}
+
+bool FrameBuffer::init(uint32_t numLeds, uint32_t capacity)
+{
+  cleanup();
+  m_numLeds = numLeds;
+  m_capacity = capacity ? capacity : DEFAULT_CAPACITY;
+  size_t planeSize = (size_t)m_capacity * m_numLeds;
+  m_red = (uint8_t *)malloc(planeSize);
+  m_green = (uint8_t *)malloc(planeSize);
+  m_blue = (uint8_t *)malloc(planeSize);
+  m_ticks = (uint32_t *)malloc((size_t)m_capacity * sizeof(uint32_t));
+  if (!m_red || !m_green || !m_blue || !m_ticks) {
+    cleanup();
+    return false;
+  }
+  return true;
+}
+
+void FrameBuffer::cleanup()
+{
+  free(m_red);
+  free(m_green);
+  free(m_blue);
+  free(m_ticks);
+  m_red = nullptr;
+  m_green = nullptr;
+  m_blue = nullptr;
+  m_ticks = nullptr;
+  m_numFrames = 0;
+  m_capacity = 0;
+}
+
+bool FrameBuffer::capture(const RGBColor *leds, uint32_t tick)
+{
+  if (m_numFrames == m_capacity && !grow()) {
+    return false;
+  }
+  size_t base = (size_t)m_numFrames * m_numLeds;
+  uint8_t *red = m_red + base;
+  uint8_t *green = m_green + base;
+  uint8_t *blue = m_blue + base;
+  for (uint32_t i = 0; i < m_numLeds; ++i) {
+    red[i] = leds[i].red;
+    green[i] = leds[i].green;
+    blue[i] = leds[i].blue;
+  }
+  m_ticks[m_numFrames++] = tick;
+  return true;
+}
+
+void FrameBuffer::frame(uint32_t index, RGBColor *out) const
+{
+  size_t base = (size_t)index * m_numLeds;
+  for (uint32_t i = 0; i < m_numLeds; ++i) {
+    out[i].red = m_red[base + i];
+    out[i].green = m_green[base + i];
+    out[i].blue = m_blue[base + i];
+  }
+}
+
+bool FrameBuffer::grow()
+{
+  if (!m_capacity) {
+    return false;
+  }
+  uint32_t capacity = m_capacity * 2;
+  size_t planeSize = (size_t)capacity * m_numLeds;
+  // the planes are updated as they move so a failure part way leaves the
+  // buffer valid at the old capacity
+  uint8_t **planes[3] = { &m_red, &m_green, &m_blue };
+  for (uint32_t i = 0; i < 3; ++i) {
+    uint8_t *plane = (uint8_t *)realloc(*planes[i], planeSize);
+    if (!plane) {
+      return false;
+    }
+    *planes[i] = plane;
+  }
+  uint32_t *ticks = (uint32_t *)realloc(m_ticks, (size_t)capacity * sizeof(uint32_t));
+  if (!ticks) {
+    return false;
+  }
+  m_ticks = ticks;
+  m_capacity = capacity;
+  return true;
+}
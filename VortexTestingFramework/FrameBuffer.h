@@ -0,0 +1,47 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+class RGBColor;
+
+// This collects the frames of a headless run so nothing is formatted or
+// written while the engine is ticking. The colors are kept as structure of
+// arrays: one plane each for red, green and blue, and each plane holds every
+// frame back to back, so led L of frame F is at index (F * numLeds) + L
+
+class FrameBuffer
+{
+public:
+  FrameBuffer();
+  ~FrameBuffer();
+
+  // allocate room for some number of frames up front, if more frames than
+  // that are captured the buffer doubles in size
+  bool init(uint32_t numLeds, uint32_t capacity);
+  void cleanup();
+
+  // copy a frame of leds into the planes along with the tick it was shown on
+  bool capture(const RGBColor *leds, uint32_t tick);
+  // rebuild a captured frame of leds
+  void frame(uint32_t index, RGBColor *out) const;
+
+  uint32_t numFrames() const { return m_numFrames; }
+  uint32_t numLeds() const { return m_numLeds; }
+  // the planes and the tick of each frame
+  const uint8_t *red() const { return m_red; }
+  const uint8_t *green() const { return m_green; }
+  const uint8_t *blue() const { return m_blue; }
+  const uint32_t *ticks() const { return m_ticks; }
+
+private:
+  bool grow();
+
+  uint32_t m_numLeds;
+  uint32_t m_numFrames;
+  uint32_t m_capacity;
+  uint8_t *m_red;
+  uint8_t *m_green;
+  uint8_t *m_blue;
+  uint32_t *m_ticks;
+};
@@ -0,0 +1,186 @@
+#include "FrameEncoder.h"
+
+#include "ColorPalette.h"
+
+#include "Colors/ColorTypes.h"
+
+#include <stdlib.h>
+
+// the pieces of a single colored led: [  ] with a 24bit background
+#define COLOR_PREFIX "\x1B[0m[\x1B[48;2;"
+#define COLOR_SUFFIX "  \x1B[0m]"
+
+char FrameEncoder::m_hexTable[256][2];
+char FrameEncoder::m_decTable[256][3];
+uint8_t FrameEncoder::m_decLen[256];
+bool FrameEncoder::m_tablesReady = false;
+
+FrameEncoder::FrameEncoder() :
+  m_buf(nullptr),
+  m_size(0),
+  m_capacity(0),
+  m_palette(nullptr)
+{
+}
+
+FrameEncoder::~FrameEncoder()
+{
+  cleanup();
+}
+
+bool FrameEncoder::init(uint32_t numLeds, size_t extra)
+{
+  initTables();
+  cleanup();
+  m_capacity = ((size_t)numLeds * maxColorBytes) + extra;
+  m_buf = (char *)malloc(m_capacity);
+  if (!m_buf) {
+    m_capacity = 0;
+    return false;
+  }
+  return true;
+}
+
+void FrameEncoder::cleanup()
+{
+  if (m_buf) {
+    free(m_buf);
+    m_buf = nullptr;
+  }
+  m_size = 0;
+  m_capacity = 0;
+}
+
+void FrameEncoder::append(const char *str, size_t len)
+{
+  // never grow, anything past the end of the buffer is dropped
+  if (len > m_capacity - m_size) {
+    len = m_capacity - m_size;
+  }
+  memcpy(m_buf + m_size, str, len);
+  m_size += len;
+}
+
+void FrameEncoder::append(char c)
+{
+  if (m_size < m_capacity) {
+    m_buf[m_size++] = c;
+  }
+}
+
+void FrameEncoder::appendRepeat(char c, size_t count)
+{
+  if (count > m_capacity - m_size) {
+    count = m_capacity - m_size;
+  }
+  memset(m_buf + m_size, c, count);
+  m_size += count;
+}
+
+void FrameEncoder::appendNumber(uint64_t num)
+{
+  // build the digits backwards at the end of a small buffer
+  char digits[20];
+  char *start = digits + sizeof(digits);
+  do {
+    *--start = '0' + (num % 10);
+    num /= 10;
+  } while (num);
+  append(start, (digits + sizeof(digits)) - start);
+}
+
+void FrameEncoder::appendHex(const RGBColor *leds, uint32_t count)
+{
+  if (((size_t)count * hexBytes) > (m_capacity - m_size)) {
+    count = (uint32_t)((m_capacity - m_size) / hexBytes);
+  }
+  char *out = m_buf + m_size;
+  for (uint32_t i = 0; i < count; ++i) {
+    memcpy(out, m_hexTable[leds[i].red], 2);
+    memcpy(out + 2, m_hexTable[leds[i].green], 2);
+    memcpy(out + 4, m_hexTable[leds[i].blue], 2);
+    out += hexBytes;
+  }
+  m_size = out - m_buf;
+}
+
+void FrameEncoder::appendColor(const RGBColor *leds, uint32_t count)
+{
+  if (m_palette && m_palette->mode() != ColorPalette::MODE_TRUECOLOR) {
+    appendPalette(leds, count);
+    return;
+  }
+  if (((size_t)count * maxColorBytes) > (m_capacity - m_size)) {
+    count = (uint32_t)((m_capacity - m_size) / maxColorBytes);
+  }
+  char *out = m_buf + m_size;
+  for (uint32_t i = 0; i < count; ++i) {
+    memcpy(out, COLOR_PREFIX, sizeof(COLOR_PREFIX) - 1);
+    out += sizeof(COLOR_PREFIX) - 1;
+    // the table entries are always 3 bytes so copy all 3 and only advance
+    // by the real length, the extra bytes are overwritten right after
+    memcpy(out, m_decTable[leds[i].red], 3);
+    out += m_decLen[leds[i].red];
+    *out++ = ';';
+    memcpy(out, m_decTable[leds[i].green], 3);
+    out += m_decLen[leds[i].green];
+    *out++ = ';';
+    memcpy(out, m_decTable[leds[i].blue], 3);
+    out += m_decLen[leds[i].blue];
+    *out++ = 'm';
+    memcpy(out, COLOR_SUFFIX, sizeof(COLOR_SUFFIX) - 1);
+    out += sizeof(COLOR_SUFFIX) - 1;
+  }
+  m_size = out - m_buf;
+}
+
+void FrameEncoder::appendPalette(const RGBColor *leds, uint32_t count)
+{
+  if (((size_t)count * ColorPalette::maxCellBytes) > (m_capacity - m_size)) {
+    count = (uint32_t)((m_capacity - m_size) / ColorPalette::maxCellBytes);
+  }
+  char *out = m_buf + m_size;
+  for (uint32_t i = 0; i < count; ++i) {
+    size_t len = m_palette->cellLen(leds[i]);
+    memcpy(out, m_palette->cell(leds[i]), len);
+    out += len;
+  }
+  m_size = out - m_buf;
+}
+
+void FrameEncoder::appendRGB(const RGBColor *leds, uint32_t count)
+{
+  if (((size_t)count * 3) > (m_capacity - m_size)) {
+    count = (uint32_t)((m_capacity - m_size) / 3);
+  }
+  uint8_t *out = (uint8_t *)m_buf + m_size;
+  for (uint32_t i = 0; i < count; ++i) {
+    out[0] = leds[i].red;
+    out[1] = leds[i].green;
+    out[2] = leds[i].blue;
+    out += 3;
+  }
+  m_size += (size_t)count * 3;
+}
+
+void FrameEncoder::initTables()
+{
+  if (m_tablesReady) {
+    return;
+  }
+  const char *digits = "0123456789ABCDEF";
+  for (uint32_t i = 0; i < 256; ++i) {
+    m_hexTable[i][0] = digits[i >> 4];
+    m_hexTable[i][1] = digits[i & 0xF];
+    uint32_t len = 0;
+    if (i >= 100) {
+      m_decTable[i][len++] = '0' + (i / 100);
+    }
+    if (i >= 10) {
+      m_decTable[i][len++] = '0' + ((i / 10) % 10);
+    }
+    m_decTable[i][len++] = '0' + (i % 10);
+    m_decLen[i] = (uint8_t)len;
+  }
+  m_tablesReady = true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+
+class RGBColor;
+class ColorPalette;
+
+// This is a reusable output buffer for the frames printed by show(), it is
+// allocated once when the leds are installed and then every frame is built
+// in-place with lookup tables instead of to_string/snprintf per led
+
+class FrameEncoder
+{
+public:
+  FrameEncoder();
+  ~FrameEncoder();
+
+  // allocate the buffer for a given number of leds plus some extra
+  // room for anything printed around the leds (borders, usage, etc)
+  bool init(uint32_t numLeds, size_t extra);
+  void cleanup();
+
+  // make appendColor use a 256 or 16 color palette instead of 24bit codes
+  void setPalette(const ColorPalette *palette) { m_palette = palette; }
+
+  // start a new frame, this does not release the buffer
+  void clear() { m_size = 0; }
+
+  // append raw text to the frame
+  void append(const char *str, size_t len);
+  void append(const char *str) { append(str, strlen(str)); }
+  void append(char c);
+  // append a character some number of times
+  void appendRepeat(char c, size_t count);
+  // append an unsigned number in decimal
+  void appendNumber(uint64_t num);
+
+  // append the leds as 6 digit uppercase hex codes (%06X)
+  void appendHex(const RGBColor *leds, uint32_t count);
+  // append the leds as 24bit console color codes, or the palette codes
+  void appendColor(const RGBColor *leds, uint32_t count);
+  // append the leds as packed red, green, blue bytes
+  void appendRGB(const RGBColor *leds, uint32_t count);
+
+  const char *data() const { return m_buf; }
+  size_t size() const { return m_size; }
+  size_t capacity() const { return m_capacity; }
+
+  // the largest amount of bytes a single led can produce in color mode
+  static const size_t maxColorBytes = 31;
+  // the amount of bytes a single led produces in hex mode
+  static const size_t hexBytes = 6;
+
+private:
+  // fill in the lookup tables, only done once
+  static void initTables();
+  void appendPalette(const RGBColor *leds, uint32_t count);
+
+  char *m_buf;
+  size_t m_size;
+  size_t m_capacity;
+  const ColorPalette *m_palette;
+
+  // two uppercase hex digits for every byte value
+  static char m_hexTable[256][2];
+  // the decimal text of every byte value and its length
+  static char m_decTable[256][3];
+  static uint8_t m_decLen[256];
+  static bool m_tablesReady;
+};
@@ -0,0 +1,69 @@
+#include "FrameSnapshot.h"
+
+#include "Colors/ColorTypes.h"
+
+#include <string.h>
+
+FrameSnapshot::FrameSnapshot() :
+  m_numLeds(0),
+  m_buffers{nullptr, nullptr, nullptr},
+  m_frames{0, 0, 0},
+  m_writeIdx(0),
+  m_readIdx(1),
+  m_middleIdx(2)
+{
+}
+
+FrameSnapshot::~FrameSnapshot()
+{
+  cleanup();
+}
+
+bool FrameSnapshot::init(uint32_t numLeds)
+{
+  cleanup();
+  m_numLeds = numLeds;
+  for (uint32_t i = 0; i < 3; ++i) {
+    m_buffers[i] = new RGBColor[numLeds];
+    m_frames[i] = 0;
+  }
+  m_writeIdx = 0;
+  m_readIdx = 1;
+  m_middleIdx.store(2);
+  return true;
+}
+
+void FrameSnapshot::cleanup()
+{
+  for (uint32_t i = 0; i < 3; ++i) {
+    if (m_buffers[i]) {
+      delete[] m_buffers[i];
+      m_buffers[i] = nullptr;
+    }
+  }
+  m_numLeds = 0;
+}
+
+void FrameSnapshot::publish(const RGBColor *leds, uint32_t frame)
+{
+  if (!m_numLeds) {
+    return;
+  }
+  memcpy((void *)m_buffers[m_writeIdx], leds, m_numLeds * sizeof(RGBColor));
+  m_frames[m_writeIdx] = frame;
+  // hand the filled buffer to the middle and take whatever was there, if the
+  // reader never took it then that frame is simply overwritten next time
+  uint32_t prev = m_middleIdx.exchange(m_writeIdx | FRESH_BIT, std::memory_order_acq_rel);
+  m_writeIdx = prev & ~FRESH_BIT;
+}
+
+const RGBColor *FrameSnapshot::acquire(uint32_t &frame)
+{
+  if (!m_numLeds || !(m_middleIdx.load(std::memory_order_relaxed) & FRESH_BIT)) {
+    return nullptr;
+  }
+  uint32_t prev = m_middleIdx.exchange(m_readIdx, std::memory_order_acq_rel);
+  m_readIdx = prev & ~FRESH_BIT;
+  frame = m_frames[m_readIdx];
+  return m_buffers[m_readIdx];
+}
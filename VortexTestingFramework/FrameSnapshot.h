@@ -0,0 +1,42 @@
+#pragma once
+
+#include <inttypes.h>
+#include <atomic>
+
+class RGBColor;
+
+// This is a lock-free slot that hands the latest frame of leds from the tick
+// thread to the render thread. There are three copies of the leds: the one the
+// tick thread writes, the one the render thread reads, and the one in the
+// middle that they swap with, so neither side ever waits on the other and the
+// render thread always gets the newest frame
+
+class FrameSnapshot
+{
+public:
+  FrameSnapshot();
+  ~FrameSnapshot();
+
+  bool init(uint32_t numLeds);
+  void cleanup();
+
+  // tick thread: copy the leds and publish them as the latest frame
+  void publish(const RGBColor *leds, uint32_t frame);
+
+  // render thread: take the latest frame if a new one was published since the
+  // last call, otherwise returns nullptr. The leds stay valid till next call
+  const RGBColor *acquire(uint32_t &frame);
+
+private:
+  // set in the middle index when it holds a frame the reader hasn't taken
+  static const uint32_t FRESH_BIT = 0x80000000;
+
+  uint32_t m_numLeds;
+  RGBColor *m_buffers[3];
+  uint32_t m_frames[3];
+  // only touched by the writer and reader respectively
+  uint32_t m_writeIdx;
+  uint32_t m_readIdx;
+  // the buffer that is swapped between the two
+  std::atomic<uint32_t> m_middleIdx;
+};
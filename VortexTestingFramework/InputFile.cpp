@@ -0,0 +1,147 @@
+#include "InputFile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+
+using namespace std;
+
+// how much has to be read past before it's given back to the kernel
+#define RELEASE_SIZE (1024 * 1024)
+
+// the line in a .test file with the input and the one that ends the header
+#define TEST_INPUT_KEY "Input="
+#define TEST_DIVIDER "----"
+
+InputFile::InputFile() :
+  m_open(false),
+  m_map(nullptr),
+  m_mapSize(0),
+  m_begin(nullptr),
+  m_end(nullptr),
+  m_pos(nullptr),
+  m_released(nullptr)
+{
+}
+
+InputFile::~InputFile()
+{
+  close();
+}
+
+bool InputFile::open(const char *filename, string &error)
+{
+  close();
+  int fd = ::open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error = "could not open the file";
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    error = "not a regular file";
+    return false;
+  }
+  m_mapSize = st.st_size;
+  if (m_mapSize) {
+    m_map = (char *)mmap(nullptr, m_mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);
+  if (m_map == MAP_FAILED) {
+    m_map = nullptr;
+    m_mapSize = 0;
+    error = "could not map the file";
+    return false;
+  }
+  if (m_map) {
+    // it's read front to back once
+    madvise(m_map, m_mapSize, MADV_SEQUENTIAL);
+  }
+  m_begin = m_map;
+  m_end = m_map + m_mapSize;
+  size_t nameLen = strlen(filename);
+  if (nameLen > 5 && strcmp(filename + nameLen - 5, ".test") == 0 && !findTestInput()) {
+    close();
+    error = "there is no " TEST_INPUT_KEY " line in the test";
+    return false;
+  }
+  m_pos = m_begin;
+  m_released = m_map;
+  m_open = true;
+  return true;
+}
+
+void InputFile::close()
+{
+  if (m_map) {
+    munmap(m_map, m_mapSize);
+  }
+  m_open = false;
+  m_map = nullptr;
+  m_mapSize = 0;
+  m_begin = m_end = m_pos = m_released = nullptr;
+}
+
+const char *InputFile::next(size_t maxLen, size_t &len)
+{
+  const char *start = m_pos;
+  const char *end = start + maxLen;
+  if (end >= m_end) {
+    end = m_end;
+  } else {
+    // back up to the command the digits at the cut belong to so it goes
+    // out whole with the next chunk
+    while (end > start && isdigit(*end)) {
+      end--;
+    }
+    if (end == start) {
+      // nothing but digits, there's no command to keep them with
+      end = start + maxLen;
+    }
+  }
+  len = end - start;
+  m_pos = end;
+  if (m_pos - m_released >= RELEASE_SIZE) {
+    // the pages are clean so this just drops them, only whole pages go
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t amount = (m_pos - m_released) & ~(page - 1);
+    // the last chunk is still being written from so it's kept
+    if (amount > page) {
+      amount -= page;
+      madvise((void *)m_released, amount, MADV_DONTNEED);
+      m_released += amount;
+    }
+  }
+  return start;
+}
+
+bool InputFile::findTestInput()
+{
+  const char *line = m_begin;
+  size_t keyLen = strlen(TEST_INPUT_KEY);
+  while (line < m_end) {
+    const char *eol = (const char *)memchr(line, '\n', m_end - line);
+    if (!eol) {
+      eol = m_end;
+    }
+    if ((size_t)(eol - line) >= strlen(TEST_DIVIDER) && memcmp(line, TEST_DIVIDER, strlen(TEST_DIVIDER)) == 0) {
+      // the frames start here, the input wasn't in the header
+      return false;
+    }
+    if ((size_t)(eol - line) >= keyLen && memcmp(line, TEST_INPUT_KEY, keyLen) == 0) {
+      m_begin = line + keyLen;
+      m_end = eol;
+      // in case it was written on windows
+      if (m_end > m_begin && m_end[-1] == '\r') {
+        m_end--;
+      }
+      return true;
+    }
+    line = eol + 1;
+  }
+  return false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <string>
+
+// This maps the --input-file into memory and hands out the commands in it a
+// chunk at a time to be written straight from the mapping into the engine's
+// input pipe. A .test file only gives out what is on its Input= line so
+// the tests can be run from the file as it is. The pages that have been
+// handed out are given back as it goes so even a huge file only ever has a
+// little of it resident
+
+class InputFile
+{
+public:
+  InputFile();
+  ~InputFile();
+
+  bool open(const char *filename, std::string &error);
+  void close();
+
+  bool isOpen() const { return m_open; }
+  bool done() const { return m_pos >= m_end; }
+
+  // the next commands, up to maxLen bytes but never cutting off part of a
+  // count, len is 0 once there is nothing left
+  const char *next(size_t maxLen, size_t &len);
+
+private:
+  // find the commands on the Input= line of a .test file
+  bool findTestInput();
+
+  bool m_open;
+  char *m_map;
+  size_t m_mapSize;
+  // the commands and how far through them it is
+  const char *m_begin;
+  const char *m_end;
+  const char *m_pos;
+  // everything before this has been given back
+  const char *m_released;
+};
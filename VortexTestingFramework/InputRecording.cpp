@@ -0,0 +1,135 @@
+#include "InputRecording.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+using namespace std;
+
+// the word on the last line instead of commands
+#define RECORDING_END "end"
+
+InputRecording::InputRecording() :
+  m_writer(),
+  m_events(),
+  m_next(0),
+  m_loaded(false),
+  m_hasEnd(false),
+  m_end(0)
+{
+}
+
+InputRecording::~InputRecording()
+{
+}
+
+bool InputRecording::create(const char *filename)
+{
+  if (!m_writer.open(filename)) {
+    return false;
+  }
+  const char *header = "# vortex input recording, the tick and the commands the engine read on it\n";
+  m_writer.write(header, strlen(header));
+  return true;
+}
+
+void InputRecording::record(uint32_t tick, const char *commands, size_t len)
+{
+  if (!m_writer.isOpen()) {
+    return;
+  }
+  // the engine skips whitespace so it's left out to keep one event a line
+  string line = to_string(tick) + " ";
+  size_t prefix = line.size();
+  for (size_t i = 0; i < len; ++i) {
+    if (!isspace(commands[i])) {
+      line += commands[i];
+    }
+  }
+  if (line.size() > prefix) {
+    line += '\n';
+    m_writer.write(line.data(), line.size());
+  }
+}
+
+void InputRecording::finish(uint32_t tick)
+{
+  if (!m_writer.isOpen()) {
+    return;
+  }
+  string line = to_string(tick) + " " RECORDING_END "\n";
+  m_writer.write(line.data(), line.size());
+  m_writer.close();
+}
+
+bool InputRecording::load(const char *filename, string &error)
+{
+  FILE *f = fopen(filename, "r");
+  if (!f) {
+    error = "could not open the file";
+    return false;
+  }
+  m_events.clear();
+  m_next = 0;
+  m_hasEnd = false;
+  char line[4096];
+  char msg[128];
+  uint32_t lineNum = 0;
+  uint32_t lastTick = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), f)) {
+    lineNum++;
+    char *pos = line;
+    while (isspace(*pos)) {
+      pos++;
+    }
+    if (!*pos || *pos == '#') {
+      continue;
+    }
+    char *end = nullptr;
+    unsigned long tick = strtoul(pos, &end, 10);
+    char *commands = end;
+    while (isspace(*commands)) {
+      commands++;
+    }
+    size_t len = strcspn(commands, " \t\r\n");
+    if (end == pos || commands == end || !len || tick > UINT32_MAX) {
+      snprintf(msg, sizeof(msg), "line %u: expected a tick and the commands", lineNum);
+      ok = false;
+    } else if (tick < lastTick || m_hasEnd) {
+      snprintf(msg, sizeof(msg), "line %u: the ticks are out of order", lineNum);
+      ok = false;
+    } else if (len == strlen(RECORDING_END) && strncmp(commands, RECORDING_END, len) == 0) {
+      m_hasEnd = true;
+      m_end = (uint32_t)tick;
+    } else {
+      m_events.push_back({ (uint32_t)tick, string(commands, len) });
+    }
+    lastTick = (uint32_t)tick;
+  }
+  fclose(f);
+  if (!ok) {
+    error = msg;
+    return false;
+  }
+  m_loaded = true;
+  return true;
+}
+
+void InputRecording::unload()
+{
+  m_events.clear();
+  m_next = 0;
+  m_loaded = false;
+  m_hasEnd = false;
+}
+
+bool InputRecording::next(uint32_t tick, string &commands)
+{
+  bool found = false;
+  while (m_next < m_events.size() && m_events[m_next].tick <= tick) {
+    commands += m_events[m_next++].commands;
+    found = true;
+  }
+  return found;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include "CommandLogWriter.h"
+
+// This is the --record-ticks file, the input commands of a run along with the
+// tick the engine read each of them on, and the --replay of one. The engine
+// only takes button input as commands so replaying the same commands on the
+// same ticks gives exactly the same run. The file is plain text:
+//
+//   # tick commands
+//   120 c
+//   480 l
+//   2000 end
+//
+// The end is the tick the run stopped on if it didn't stop with a q, the
+// lines are streamed out through a CommandLogWriter as they are recorded
+
+class InputRecording
+{
+public:
+  struct Event
+  {
+    uint32_t tick;
+    std::string commands;
+  };
+
+  InputRecording();
+  ~InputRecording();
+
+  // record into a new file
+  bool create(const char *filename);
+  void record(uint32_t tick, const char *commands, size_t len);
+  // write the end and close the file
+  void finish(uint32_t tick);
+  bool isRecording() const { return m_writer.isOpen(); }
+  void poll(uint64_t now) { m_writer.poll(now); }
+
+  // read a recording to replay or convert
+  bool load(const char *filename, std::string &error);
+  bool isLoaded() const { return m_loaded; }
+  void unload();
+  // append the commands that are due by this tick and weren't given out yet,
+  // false if there weren't any
+  bool next(uint32_t tick, std::string &commands);
+  // whether the run stopped before this tick
+  bool ended(uint32_t tick) const { return m_hasEnd && tick >= m_end; }
+
+  const std::vector<Event> &events() const { return m_events; }
+  bool hasEnd() const { return m_hasEnd; }
+  uint32_t endTick() const { return m_end; }
+
+private:
+  CommandLogWriter m_writer;
+  std::vector<Event> m_events;
+  // the next event to replay
+  size_t m_next;
+  bool m_loaded;
+  bool m_hasEnd;
+  uint32_t m_end;
+};
@@ -0,0 +1,327 @@
+#include "InputScript.h"
+
+#include <string.h>
+#include <ctype.h>
+#include <stdio.h>
+
+using namespace std;
+
+// the commands a script can send, the same ones the engine reads
+#define SCRIPT_COMMANDS "clmadsftrwq"
+
+// room for a command and the longest count
+#define MAX_COMMAND_SIZE 12
+
+InputScript::InputScript() :
+  m_ops(),
+  m_macros(),
+  m_pc(0),
+  m_depth(0),
+  m_stack(),
+  m_command(0),
+  m_pending(0)
+{
+}
+
+// a loop or macro that is still open while compiling
+struct Block
+{
+  bool isMacro;
+  // the LOOP op or the JUMP over the macro body
+  uint32_t op;
+  uint32_t line;
+  // the deepest the stack gets inside relative to the block
+  uint32_t depth;
+  bool emits;
+  string name;
+};
+
+// read a count, false if it doesn't fit
+static bool parseCount(const char *source, size_t len, size_t &pos, uint32_t &count)
+{
+  uint64_t value = 0;
+  while (pos < len && isdigit(source[pos])) {
+    value = (value * 10) + (source[pos++] - '0');
+    if (value > UINT32_MAX) {
+      return false;
+    }
+  }
+  count = (uint32_t)value;
+  return true;
+}
+
+bool InputScript::compile(const char *source, size_t len, string &error)
+{
+  m_ops.clear();
+  m_macros.clear();
+  m_pc = 0;
+  m_depth = 0;
+  m_command = 0;
+  m_pending = 0;
+  // the bottom block is the script itself
+  vector<Block> blocks(1);
+  blocks[0].isMacro = false;
+  blocks[0].op = 0;
+  blocks[0].line = 1;
+  blocks[0].depth = 0;
+  blocks[0].emits = false;
+  uint32_t line = 1;
+  char msg[128];
+  size_t pos = 0;
+  while (pos < len) {
+    char c = source[pos];
+    if (c == '\n') {
+      line++;
+      pos++;
+      continue;
+    }
+    if (isspace(c)) {
+      pos++;
+      continue;
+    }
+    if (c == '#') {
+      while (pos < len && source[pos] != '\n') {
+        pos++;
+      }
+      continue;
+    }
+    Block &block = blocks.back();
+    if (strchr(SCRIPT_COMMANDS, c)) {
+      uint32_t count = 1;
+      pos++;
+      if (pos < len && isdigit(source[pos]) && !parseCount(source, len, pos, count)) {
+        snprintf(msg, sizeof(msg), "line %u: the count of '%c' is too large", line, c);
+        error = msg;
+        return false;
+      }
+      if (count) {
+        m_ops.push_back({ OP_COMMAND, c, count, 0 });
+        block.emits = true;
+      }
+      continue;
+    }
+    if (c == '(') {
+      blocks.push_back({ false, (uint32_t)m_ops.size(), line, 0, false, "" });
+      m_ops.push_back({ OP_LOOP, 0, 0, 0 });
+      pos++;
+      continue;
+    }
+    if (c == ')') {
+      if (block.isMacro || blocks.size() == 1) {
+        snprintf(msg, sizeof(msg), "line %u: ')' without a '('", line);
+        error = msg;
+        return false;
+      }
+      pos++;
+      while (pos < len && (source[pos] == ' ' || source[pos] == '\t')) {
+        pos++;
+      }
+      // a loop without a count runs once
+      uint32_t count = 1;
+      if (pos < len && source[pos] == 'x') {
+        pos++;
+        if (pos >= len || !isdigit(source[pos]) || !parseCount(source, len, pos, count)) {
+          snprintf(msg, sizeof(msg), "line %u: expected a loop count after 'x'", line);
+          error = msg;
+          return false;
+        }
+      }
+      if (!block.emits) {
+        // it would spin forever without the engine ever getting anything
+        snprintf(msg, sizeof(msg), "line %u: the loop from line %u never sends a command", line, block.line);
+        error = msg;
+        return false;
+      }
+      uint32_t start = block.op;
+      m_ops.push_back({ OP_NEXT, 0, 0, start + 1 });
+      m_ops[start].arg = count;
+      m_ops[start].target = (uint32_t)m_ops.size();
+      Block &parent = blocks[blocks.size() - 2];
+      if (block.depth + 1 > parent.depth) {
+        parent.depth = block.depth + 1;
+      }
+      parent.emits = parent.emits || count;
+      blocks.pop_back();
+      if (blocks.back().depth > MAX_DEPTH) {
+        snprintf(msg, sizeof(msg), "line %u: loops and macros are nested too deep", line);
+        error = msg;
+        return false;
+      }
+      continue;
+    }
+    if (c == '@') {
+      size_t start = ++pos;
+      while (pos < len && (isalnum(source[pos]) || source[pos] == '_')) {
+        pos++;
+      }
+      string name(source + start, pos - start);
+      if (name.empty()) {
+        snprintf(msg, sizeof(msg), "line %u: expected a macro name after '@'", line);
+        error = msg;
+        return false;
+      }
+      size_t next = pos;
+      while (next < len && (source[next] == ' ' || source[next] == '\t')) {
+        next++;
+      }
+      if (next < len && source[next] == '{') {
+        // a definition, the body is jumped over where it's written
+        if (blocks.size() != 1) {
+          snprintf(msg, sizeof(msg), "line %u: macro @%s has to be defined outside of loops and macros", line, name.c_str());
+          error = msg;
+          return false;
+        }
+        if (findMacro(name)) {
+          snprintf(msg, sizeof(msg), "line %u: macro @%s is already defined", line, name.c_str());
+          error = msg;
+          return false;
+        }
+        blocks.push_back({ true, (uint32_t)m_ops.size(), line, 0, false, name });
+        m_ops.push_back({ OP_JUMP, 0, 0, 0 });
+        pos = next + 1;
+        continue;
+      }
+      // a call, only macros defined before it so they can't recurse
+      const Macro *macro = findMacro(name);
+      if (!macro) {
+        snprintf(msg, sizeof(msg), "line %u: unknown macro @%s", line, name.c_str());
+        error = msg;
+        return false;
+      }
+      if (macro->emits) {
+        m_ops.push_back({ OP_CALL, 0, 0, macro->start });
+        block.emits = true;
+        if (macro->depth + 1 > block.depth) {
+          block.depth = macro->depth + 1;
+        }
+      }
+      if (block.depth > MAX_DEPTH) {
+        snprintf(msg, sizeof(msg), "line %u: loops and macros are nested too deep", line);
+        error = msg;
+        return false;
+      }
+      continue;
+    }
+    if (c == '}') {
+      if (!block.isMacro) {
+        snprintf(msg, sizeof(msg), "line %u: '}' without a macro", line);
+        error = msg;
+        return false;
+      }
+      m_ops.push_back({ OP_RETURN, 0, 0, 0 });
+      m_ops[block.op].target = (uint32_t)m_ops.size();
+      m_macros.push_back({ block.name, block.op + 1, block.depth, block.emits });
+      blocks.pop_back();
+      pos++;
+      continue;
+    }
+    snprintf(msg, sizeof(msg), "line %u: unexpected '%c'", line, c);
+    error = msg;
+    return false;
+  }
+  if (blocks.size() > 1) {
+    snprintf(msg, sizeof(msg), "line %u: missing '%c'", blocks.back().line, blocks.back().isMacro ? '}' : ')');
+    error = msg;
+    return false;
+  }
+  if (!blocks[0].emits) {
+    error = "the script doesn't send any commands";
+    return false;
+  }
+  return true;
+}
+
+bool InputScript::loadFile(const char *filename, string &error)
+{
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    error = "could not open the file";
+    return false;
+  }
+  string source;
+  char buf[4096];
+  size_t amt;
+  while ((amt = fread(buf, 1, sizeof(buf), f)) > 0) {
+    source.append(buf, amt);
+  }
+  fclose(f);
+  return compile(source.data(), source.size(), error);
+}
+
+void InputScript::unload()
+{
+  m_ops.clear();
+  m_macros.clear();
+  m_pc = 0;
+  m_depth = 0;
+  m_pending = 0;
+}
+
+size_t InputScript::generate(char *buf, size_t size, uint32_t maxRepeat, uint64_t &ticks)
+{
+  size_t len = 0;
+  while (len + MAX_COMMAND_SIZE <= size) {
+    if (m_pending) {
+      // the count of a rapid click is how many clicks so it's never split
+      uint32_t count = m_pending;
+      if (maxRepeat && count > maxRepeat && m_command != 'r') {
+        count = maxRepeat;
+      }
+      buf[len++] = m_command;
+      if (count > 1) {
+        len += snprintf(buf + len, size - len, "%u", count);
+      }
+      m_pending -= count;
+      ticks += count;
+      continue;
+    }
+    if (m_pc >= m_ops.size()) {
+      break;
+    }
+    const Op &op = m_ops[m_pc];
+    switch (op.type) {
+    case OP_COMMAND:
+      m_command = op.command;
+      m_pending = op.arg;
+      m_pc++;
+      break;
+    case OP_LOOP:
+      if (!op.arg) {
+        m_pc = op.target;
+        break;
+      }
+      m_stack[m_depth++] = { m_pc + 1, op.arg };
+      m_pc++;
+      break;
+    case OP_NEXT:
+      if (--m_stack[m_depth - 1].remaining) {
+        m_pc = op.target;
+      } else {
+        m_depth--;
+        m_pc++;
+      }
+      break;
+    case OP_CALL:
+      m_stack[m_depth++] = { m_pc + 1, 0 };
+      m_pc = op.target;
+      break;
+    case OP_RETURN:
+      m_pc = m_stack[--m_depth].pc;
+      break;
+    case OP_JUMP:
+      m_pc = op.target;
+      break;
+    }
+  }
+  return len;
+}
+
+const InputScript::Macro *InputScript::findMacro(const string &name) const
+{
+  for (size_t i = 0; i < m_macros.size(); ++i) {
+    if (m_macros[i].name == name) {
+      return &m_macros[i];
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+// This compiles an input script for --script into a small program and then
+// plays it back as the plain input commands the engine reads. On top of the
+// commands a script has comments, loops and macros:
+//
+//   # open the menus and pick the third entry
+//   @menu { m c3 l }
+//   @menu w1000
+//   (c w300)x500        # the body runs 500 times
+//
+// The program is a list of ops with jumps for the loops and calls for the
+// macros, playing it back only needs a position and a small stack so a
+// script that runs for millions of ticks never gets expanded in memory
+
+class InputScript
+{
+public:
+  InputScript();
+
+  // compile the script, on failure the error says what and where
+  bool compile(const char *source, size_t len, std::string &error);
+  bool loadFile(const char *filename, std::string &error);
+
+  bool isLoaded() const { return !m_ops.empty(); }
+  void unload();
+  bool done() const { return m_pc >= m_ops.size() && !m_pending; }
+
+  // write the next commands into buf, counts over maxRepeat are split into
+  // several commands (0 means no limit) and ticks is increased by how many
+  // ticks the engine will take to get through what was written
+  size_t generate(char *buf, size_t size, uint32_t maxRepeat, uint64_t &ticks);
+
+private:
+  enum OpType : uint8_t
+  {
+    OP_COMMAND,
+    // start a loop, arg is the count and target is the op after the end
+    OP_LOOP,
+    // end of a loop body, target is the first op of the body
+    OP_NEXT,
+    OP_CALL,
+    OP_RETURN,
+    OP_JUMP,
+  };
+
+  struct Op
+  {
+    OpType type;
+    char command;
+    uint32_t arg;
+    uint32_t target;
+  };
+
+  struct Macro
+  {
+    std::string name;
+    uint32_t start;
+    // how deep the stack gets while it runs
+    uint32_t depth;
+    // whether it sends anything at all
+    bool emits;
+  };
+
+  struct Frame
+  {
+    // the loop body start or the op to return to
+    uint32_t pc;
+    uint32_t remaining;
+  };
+
+  // nested loops and macro calls
+  static const uint32_t MAX_DEPTH = 64;
+
+  const Macro *findMacro(const std::string &name) const;
+
+  std::vector<Op> m_ops;
+  std::vector<Macro> m_macros;
+
+  // the playback state
+  uint32_t m_pc;
+  uint32_t m_depth;
+  Frame m_stack[MAX_DEPTH];
+  char m_command;
+  uint32_t m_pending;
+};
@@ -0,0 +1,148 @@
+#include "LatencyHistogram.h"
+
+#include <string.h>
+
+// the widest bar printed for a row of the histogram
+#define BAR_WIDTH 40
+
+LatencyHistogram::LatencyHistogram() :
+  m_buckets(),
+  m_count(0),
+  m_total(0),
+  m_min(0),
+  m_max(0)
+{
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+  m_buckets[bucketOf(ns)]++;
+  if (!m_count || ns < m_min) {
+    m_min = ns;
+  }
+  if (ns > m_max) {
+    m_max = ns;
+  }
+  m_count++;
+  m_total += ns;
+}
+
+void LatencyHistogram::clear()
+{
+  memset(m_buckets, 0, sizeof(m_buckets));
+  m_count = 0;
+  m_total = 0;
+  m_min = 0;
+  m_max = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const
+{
+  if (!m_count) {
+    return 0;
+  }
+  uint64_t target = (uint64_t)((percent / 100.0) * m_count);
+  if (target < 1) {
+    target = 1;
+  }
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+    seen += m_buckets[i];
+    if (seen >= target) {
+      // never claim more than what was actually seen
+      uint64_t top = bucketTop(i);
+      return (top > m_max) ? m_max : top;
+    }
+  }
+  return m_max;
+}
+
+void LatencyHistogram::print(FILE *out, const char *indent) const
+{
+  if (!m_count) {
+    return;
+  }
+  // the sub buckets are added up into one row per power of two
+  uint64_t rows[MAX_POW + 1];
+  memset(rows, 0, sizeof(rows));
+  for (uint32_t i = 0; i < NUM_BUCKETS; ++i) {
+    uint32_t pow = (i / SUB_BUCKETS) + SUB_BITS - 1;
+    if (i < SUB_BUCKETS) {
+      // the first buckets are the exact values 0-7
+      pow = i ? (31 - __builtin_clz(i)) : 0;
+    }
+    if (pow > MAX_POW) {
+      // the last buckets only hold the values that were clamped
+      pow = MAX_POW;
+    }
+    rows[pow] += m_buckets[i];
+  }
+  uint32_t first = 0;
+  uint32_t last = 0;
+  uint64_t biggest = 0;
+  for (uint32_t p = 0; p <= MAX_POW; ++p) {
+    if (!rows[p]) {
+      continue;
+    }
+    if (!biggest) {
+      first = p;
+    }
+    last = p;
+    if (rows[p] > biggest) {
+      biggest = rows[p];
+    }
+  }
+  for (uint32_t p = first; p <= last; ++p) {
+    uint64_t low = p ? (1ull << p) : 0;
+    fprintf(out, "%s", indent);
+    printDuration(out, low);
+    fprintf(out, " - ");
+    printDuration(out, (2ull << p) - 1);
+    fprintf(out, ": %10" PRIu64 " %6.2f%% ", rows[p], (rows[p] * 100.0) / m_count);
+    uint32_t bar = (uint32_t)((rows[p] * BAR_WIDTH) / biggest);
+    if (!bar && rows[p]) {
+      bar = 1;
+    }
+    for (uint32_t i = 0; i < bar; ++i) {
+      fputc('#', out);
+    }
+    fputc('\n', out);
+  }
+}
+
+uint32_t LatencyHistogram::bucketOf(uint64_t ns)
+{
+  if (ns < SUB_BUCKETS) {
+    return (uint32_t)ns;
+  }
+  uint32_t pow = 63 - __builtin_clzll(ns);
+  if (pow > MAX_POW) {
+    return NUM_BUCKETS - 1;
+  }
+  uint32_t sub = (uint32_t)(ns >> (pow - SUB_BITS)) & (SUB_BUCKETS - 1);
+  return ((pow - SUB_BITS + 1) * SUB_BUCKETS) + sub;
+}
+
+uint64_t LatencyHistogram::bucketTop(uint32_t bucket)
+{
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+  uint32_t pow = (bucket / SUB_BUCKETS) + SUB_BITS - 1;
+  uint32_t sub = bucket % SUB_BUCKETS;
+  uint64_t step = 1ull << (pow - SUB_BITS);
+  return ((SUB_BUCKETS + sub) * step) + step - 1;
+}
+
+void printDuration(FILE *out, uint64_t ns)
+{
+  if (ns < 1000) {
+    fprintf(out, "%6" PRIu64 "ns", ns);
+  } else if (ns < 1000000) {
+    fprintf(out, "%6.1fus", ns / 1000.0);
+  } else if (ns < 1000000000) {
+    fprintf(out, "%6.1fms", ns / 1000000.0);
+  } else {
+    fprintf(out, "%6.2fs ", ns / 1000000000.0);
+  }
+}
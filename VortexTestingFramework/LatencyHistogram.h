@@ -0,0 +1,51 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// This counts durations in nanoseconds into log-linear buckets: every power
+// of two is split into a few linear steps, so any value lands in a bucket
+// within about 12% of it without storing the values themselves. Recording is
+// a couple of shifts and an increment so it's cheap enough to do every tick
+
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  void record(uint64_t ns);
+  void clear();
+
+  uint64_t count() const { return m_count; }
+  uint64_t min() const { return m_count ? m_min : 0; }
+  uint64_t max() const { return m_max; }
+  uint64_t mean() const { return m_count ? (m_total / m_count) : 0; }
+  uint64_t total() const { return m_total; }
+  // the value that a percent (0-100) of the recorded values are at or below,
+  // this is the top of the bucket it lands in
+  uint64_t percentile(double percent) const;
+
+  // print the count of each power of two range with a bar
+  void print(FILE *out, const char *indent) const;
+
+private:
+  // each power of two is split into this many steps
+  static const uint32_t SUB_BITS = 3;
+  static const uint32_t SUB_BUCKETS = 1 << SUB_BITS;
+  // enough for values up to about 18 minutes
+  static const uint32_t MAX_POW = 40;
+  static const uint32_t NUM_BUCKETS = (MAX_POW + 1) * SUB_BUCKETS;
+
+  static uint32_t bucketOf(uint64_t ns);
+  static uint64_t bucketTop(uint32_t bucket);
+
+  uint64_t m_buckets[NUM_BUCKETS];
+  uint64_t m_count;
+  uint64_t m_total;
+  uint64_t m_min;
+  uint64_t m_max;
+};
+
+// print a duration in ns with a unit that suits it
+void printDuration(FILE *out, uint64_t ns);
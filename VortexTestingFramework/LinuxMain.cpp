@@ -6,8 +6,10 @@ int main(int argc, char *argv[])
   framework.init(argc, argv);
 #ifndef WASM
   while (framework.stillRunning()) {
+    // sleep while the engine has nothing to do
+    framework.wait();
     framework.run();
   }
 #endif
-  return 0;
+  return framework.exitCode();
 }
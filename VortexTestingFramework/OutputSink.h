@@ -0,0 +1,156 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "FrameEncoder.h"
+#include "OutputWriter.h"
+
+class RGBColor;
+class ColorPalette;
+
+// This is where the text frames from show() end up. Each kind of output is a
+// small class with a write() for one frame, the one picked on the command line
+// is bound to an OutputSink once at startup. Because the sinks are templates
+// the formatting of a whole frame is inlined into a single function and the
+// only cost of picking it at runtime is one call through a pointer per frame.
+// When nothing is bound that is the null output, show() still does all of its
+// bookkeeping but no frame is ever formatted or written, so the engine can be
+// timed without the cost of the output
+
+// the text formats a frame can be written in
+struct HexFormat
+{
+  static void append(FrameEncoder &encoder, const RGBColor *leds, uint32_t count)
+  {
+    encoder.appendHex(leds, count);
+  }
+};
+
+struct ColorFormat
+{
+  static void append(FrameEncoder &encoder, const RGBColor *leds, uint32_t count)
+  {
+    encoder.appendColor(leds, count);
+  }
+};
+
+// formats each frame into a line and hands it to a writer, this is both the
+// terminal output on stdout and the file output
+template <typename Format>
+class FormatSink
+{
+public:
+  FormatSink(OutputWriter *writer, uint32_t numLeds, const ColorPalette *palette) :
+    m_writer(writer),
+    m_encoder()
+  {
+    // room for the newline and repeat count
+    m_encoder.init(numLeds, 32);
+    m_encoder.setPalette(palette);
+  }
+
+  // write a frame that was shown some number of times in a row
+  void write(const RGBColor *leds, uint32_t count, uint32_t repeat)
+  {
+    m_encoder.clear();
+    Format::append(m_encoder, leds, count);
+    if (repeat > 1) {
+      m_encoder.append('*');
+      m_encoder.appendNumber(repeat);
+    }
+    m_encoder.append('\n');
+    m_writer->write(m_encoder.data(), m_encoder.size());
+  }
+
+private:
+  OutputWriter *m_writer;
+  FrameEncoder m_encoder;
+};
+
+// writes every frame to two sinks, like a live view and a golden file
+template <typename First, typename Second>
+class TeeSink
+{
+public:
+  // takes ownership of both sinks
+  TeeSink(First *first, Second *second) :
+    m_first(first),
+    m_second(second)
+  {
+  }
+  ~TeeSink()
+  {
+    delete m_first;
+    delete m_second;
+  }
+
+  void write(const RGBColor *leds, uint32_t count, uint32_t repeat)
+  {
+    m_first->write(leds, count, repeat);
+    m_second->write(leds, count, repeat);
+  }
+
+private:
+  First *m_first;
+  Second *m_second;
+};
+
+// the handle that show() writes frames through
+class OutputSink
+{
+public:
+  OutputSink() :
+    m_sink(nullptr),
+    m_write(nullptr),
+    m_destroy(nullptr)
+  {
+  }
+  ~OutputSink()
+  {
+    cleanup();
+  }
+
+  // take ownership of a sink allocated with new
+  template <typename Sink>
+  void bind(Sink *sink)
+  {
+    cleanup();
+    m_sink = sink;
+    m_write = &writeSink<Sink>;
+    m_destroy = &destroySink<Sink>;
+  }
+  void cleanup()
+  {
+    if (m_sink) {
+      m_destroy(m_sink);
+    }
+    m_sink = nullptr;
+    m_write = nullptr;
+    m_destroy = nullptr;
+  }
+
+  // false for the null output
+  bool isActive() const { return m_sink != nullptr; }
+
+  void write(const RGBColor *leds, uint32_t count, uint32_t repeat)
+  {
+    m_write(m_sink, leds, count, repeat);
+  }
+
+private:
+  template <typename Sink>
+  static void writeSink(void *sink, const RGBColor *leds, uint32_t count, uint32_t repeat)
+  {
+    ((Sink *)sink)->write(leds, count, repeat);
+  }
+  template <typename Sink>
+  static void destroySink(void *sink)
+  {
+    delete (Sink *)sink;
+  }
+
+  void *m_sink;
+  void (*m_write)(void *sink, const RGBColor *leds, uint32_t count, uint32_t repeat);
+  void (*m_destroy)(void *sink);
+};
@@ -0,0 +1,326 @@
+#include "OutputWriter.h"
+#include "LatencyHistogram.h"
+
+#include <sys/uio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+// the writer thread waits until at least this much is in the ring before it
+// writes anything, unless it's being stopped or it times out
+#define WRITER_BATCH_SIZE (64 * 1024)
+// how long either side sleeps before checking the ring again on its own
+#define WRITER_TIMEOUT_MS 10
+#define PRODUCER_TIMEOUT_MS 1
+// how long a signal handler waits for a write that's already going, or for
+// room in a full pipe, before it gives up on the rest of the ring
+#define SIGNAL_TIMEOUT_MS 1000
+
+// the writers with a ring, there's only the stdout and the --output file
+#define MAX_WRITERS 4
+static OutputWriter *volatile g_writers[MAX_WRITERS] = { nullptr };
+
+OutputWriter::OutputWriter() :
+  m_fd(-1),
+  m_ring(nullptr),
+  m_capacity(0),
+  m_head(0),
+  m_tail(0),
+  m_running(false),
+  m_writing(false),
+  m_killed(false),
+  m_writerWaiting(false),
+  m_producerWaiting(false),
+  m_mutex(),
+  m_writerCond(),
+  m_producerCond(),
+  m_thread(),
+  m_highWater(0),
+  m_numStalls(0),
+  m_numSyscalls(0),
+  m_profile(nullptr)
+{
+}
+
+OutputWriter::~OutputWriter()
+{
+  cleanup();
+}
+
+bool OutputWriter::init(int fd, size_t capacity)
+{
+  cleanup();
+  m_fd = fd;
+  if (!capacity) {
+    m_capacity = 0;
+    return true;
+  }
+  m_capacity = 1;
+  while (m_capacity < capacity) {
+    m_capacity <<= 1;
+  }
+  m_ring = (char *)malloc(m_capacity);
+  if (!m_ring) {
+    m_capacity = 0;
+    return false;
+  }
+  m_head = 0;
+  m_tail = 0;
+  m_highWater = 0;
+  m_numStalls = 0;
+  m_numSyscalls = 0;
+  m_writing = false;
+  m_killed = false;
+  m_running = true;
+  // the signals that drain the ring are kept off the writer thread so the
+  // handler never runs in the middle of one of its own writes
+  sigset_t mask, old;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &mask, &old);
+  m_thread = thread(&OutputWriter::writerLoop, this);
+  pthread_sigmask(SIG_SETMASK, &old, nullptr);
+  for (uint32_t i = 0; i < MAX_WRITERS; ++i) {
+    if (!g_writers[i]) {
+      g_writers[i] = this;
+      break;
+    }
+  }
+  return true;
+}
+
+void OutputWriter::cleanup()
+{
+  if (!m_ring) {
+    return;
+  }
+  for (uint32_t i = 0; i < MAX_WRITERS; ++i) {
+    if (g_writers[i] == this) {
+      g_writers[i] = nullptr;
+    }
+  }
+  // the writer drains everything before it exits
+  m_running.store(false, memory_order_release);
+  m_writerCond.notify_one();
+  m_thread.join();
+  free(m_ring);
+  m_ring = nullptr;
+}
+
+void OutputWriter::write(const void *data, size_t len)
+{
+  const char *src = (const char *)data;
+  if (!m_ring) {
+    writeDirect(src, len);
+    return;
+  }
+  while (len > 0) {
+    uint64_t head = m_head.load(memory_order_relaxed);
+    size_t used = (size_t)(head - m_tail.load(memory_order_acquire));
+    size_t space = m_capacity - used;
+    if (!space) {
+      // full, make sure the writer is awake then wait for it
+      m_numStalls++;
+      unique_lock<mutex> lock(m_mutex);
+      m_producerWaiting.store(true);
+      m_writerCond.notify_one();
+      if (m_head.load(memory_order_relaxed) - m_tail.load(memory_order_acquire) == m_capacity) {
+        m_producerCond.wait_for(lock, chrono::milliseconds(PRODUCER_TIMEOUT_MS));
+      }
+      m_producerWaiting.store(false);
+      continue;
+    }
+    size_t amt = min(len, space);
+    size_t pos = (size_t)(head & (m_capacity - 1));
+    size_t first = min(amt, m_capacity - pos);
+    memcpy(m_ring + pos, src, first);
+    memcpy(m_ring, src + first, amt - first);
+    m_head.store(head + amt, memory_order_release);
+    if (used + amt > m_highWater) {
+      m_highWater = used + amt;
+    }
+    src += amt;
+    len -= amt;
+    // only bother the writer once there's a full batch for it
+    if (used + amt >= WRITER_BATCH_SIZE && m_writerWaiting.load()) {
+      m_writerCond.notify_one();
+    }
+  }
+}
+
+void OutputWriter::writerLoop()
+{
+  size_t batch = min((size_t)WRITER_BATCH_SIZE, m_capacity / 2);
+  while (true) {
+    uint64_t tail = m_tail.load(memory_order_relaxed);
+    uint64_t head = m_head.load(memory_order_acquire);
+    bool running = m_running.load(memory_order_acquire);
+    if (running && (head - tail) < batch) {
+      // wait for a full batch, the producer to fill up, a stop or a timeout
+      unique_lock<mutex> lock(m_mutex);
+      m_writerWaiting.store(true);
+      if (m_running.load() && (m_head.load(memory_order_acquire) - tail) < batch) {
+        m_writerCond.wait_for(lock, chrono::milliseconds(WRITER_TIMEOUT_MS));
+      }
+      m_writerWaiting.store(false);
+      head = m_head.load(memory_order_acquire);
+      running = m_running.load(memory_order_acquire);
+    }
+    if (head == tail) {
+      if (!running) {
+        break;
+      }
+      continue;
+    }
+    // if the fd is broken the data is dropped so the producer never hangs
+    if (!drain(tail, head) && m_killed.load()) {
+      // a signal handler is writing the rest
+      break;
+    }
+    m_tail.store(head, memory_order_release);
+    if (m_producerWaiting.load()) {
+      m_producerCond.notify_one();
+    }
+  }
+}
+
+void OutputWriter::writeDirect(const char *data, size_t len)
+{
+#ifdef WASM
+  if (m_fd == STDOUT_FILENO) {
+    fwrite(data, 1, len, stdout);
+    fflush(stdout);
+    return;
+  }
+#endif
+  while (len > 0) {
+    uint64_t start = m_profile ? now() : 0;
+    ssize_t written = ::write(m_fd, data, len);
+    if (m_profile) {
+      m_profile->record(now() - start);
+    }
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        // stdout may be non-blocking because it shares the terminal with
+        // stdin, so wait for room instead of dropping part of the frame
+        struct pollfd pfd = { m_fd, POLLOUT, 0 };
+        poll(&pfd, 1, -1);
+        continue;
+      }
+      break;
+    }
+    data += written;
+    len -= written;
+    // without a ring the tail only counts the bytes for the stats
+    m_tail.store(m_tail.load(memory_order_relaxed) + written, memory_order_relaxed);
+  }
+}
+
+bool OutputWriter::drain(uint64_t tail, uint64_t head)
+{
+  while (tail < head) {
+    size_t pos = (size_t)(tail & (m_capacity - 1));
+    size_t amt = (size_t)(head - tail);
+    size_t first = min(amt, m_capacity - pos);
+    // the second part is only needed when the data wraps around the ring
+    struct iovec iov[2] = {
+      { m_ring + pos, first },
+      { m_ring, amt - first },
+    };
+    // set before the check so a signal handler either sees this write and
+    // waits for it or this sees the handler and leaves the rest to it
+    m_writing.store(true);
+    if (m_killed.load()) {
+      m_writing.store(false);
+      return false;
+    }
+    uint64_t start = m_profile ? now() : 0;
+    ssize_t written = writev(m_fd, iov, (amt > first) ? 2 : 1);
+    if (m_profile) {
+      m_profile->record(now() - start);
+    }
+    m_numSyscalls.fetch_add(1, memory_order_relaxed);
+    if (written < 0) {
+      if (errno == EINTR) {
+        m_writing.store(false);
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        // stdout shares the non-blocking flag with the terminal on stdin
+        struct pollfd pfd = { m_fd, POLLOUT, 0 };
+        poll(&pfd, 1, -1);
+        m_writing.store(false);
+        continue;
+      }
+      m_writing.store(false);
+      return false;
+    }
+    // kept up to date as it goes so a handler knows where to pick it up
+    tail += written;
+    m_tail.store(tail, memory_order_release);
+    m_writing.store(false);
+  }
+  return true;
+}
+
+void OutputWriter::drainAll()
+{
+  for (uint32_t i = 0; i < MAX_WRITERS; ++i) {
+    OutputWriter *writer = g_writers[i];
+    if (writer) {
+      writer->drainOnSignal();
+    }
+  }
+}
+
+void OutputWriter::drainOnSignal()
+{
+  m_killed.store(true);
+  // let a write that's already going finish so the rest comes after it
+  struct timespec ms = { 0, 1000000 };
+  for (uint32_t i = 0; m_writing.load() && i < SIGNAL_TIMEOUT_MS; ++i) {
+    nanosleep(&ms, nullptr);
+  }
+  if (m_writing.load()) {
+    // stuck on an fd that isn't taking anything
+    return;
+  }
+  uint64_t tail = m_tail.load(memory_order_acquire);
+  uint64_t head = m_head.load(memory_order_acquire);
+  while (tail < head) {
+    size_t pos = (size_t)(tail & (m_capacity - 1));
+    size_t amt = min((size_t)(head - tail), m_capacity - pos);
+    ssize_t written = ::write(m_fd, m_ring + pos, amt);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      struct pollfd pfd = { m_fd, POLLOUT, 0 };
+      if ((errno == EAGAIN || errno == EWOULDBLOCK) && poll(&pfd, 1, SIGNAL_TIMEOUT_MS) > 0) {
+        continue;
+      }
+      return;
+    }
+    tail += written;
+  }
+}
+
+uint64_t OutputWriter::now()
+{
+  return chrono::duration_cast<chrono::nanoseconds>(
+    chrono::steady_clock::now().time_since_epoch()).count();
+}
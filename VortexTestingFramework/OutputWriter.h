@@ -0,0 +1,93 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+class LatencyHistogram;
+
+// This is an asynchronous writer for the frame output, the tick thread copies
+// each frame into a single-producer/single-consumer ring and a writer thread
+// drains the ring into the file descriptor with large writev batches so there
+// are only a handful of syscalls instead of a printf and fflush per tick
+
+class OutputWriter
+{
+public:
+  OutputWriter();
+  ~OutputWriter();
+
+  // start the writer thread for a file descriptor, the capacity of the ring is
+  // rounded up to a power of two. With no capacity there is no thread and
+  // every write goes straight to the fd
+  bool init(int fd, size_t capacity);
+  // write everything that is left and stop the writer thread
+  void cleanup();
+
+  bool isActive() const { return m_ring != nullptr; }
+  int fd() const { return m_fd; }
+  // time every write syscall into a histogram (for --profile), this has to
+  // be set before init because the writer thread records into it
+  void setProfile(LatencyHistogram *writes) { m_profile = writes; }
+
+  // producer: copy data into the ring, waits for space if the ring is full
+  void write(const void *data, size_t len);
+
+  // write out what's left in the ring of every writer from the handler of a
+  // signal that kills the process, the writer threads stop taking anything
+  // new and only write() and poll() are used
+  static void drainAll();
+
+  // the most bytes that were ever waiting in the ring
+  size_t highWater() const { return m_highWater; }
+  size_t capacity() const { return m_capacity; }
+  uint64_t bytesWritten() const { return m_tail.load(std::memory_order_relaxed); }
+  // the number of writev calls made by the writer thread
+  uint64_t numSyscalls() const { return m_numSyscalls.load(std::memory_order_relaxed); }
+  // the number of times the producer had to wait for space
+  uint64_t numStalls() const { return m_numStalls; }
+
+private:
+  void writerLoop();
+  // write straight to the fd when there is no writer thread
+  void writeDirect(const char *data, size_t len);
+  // write the given range of the ring, returns false if the fd is broken or
+  // a signal handler took over the ring
+  bool drain(uint64_t tail, uint64_t head);
+  // the part of drainAll for a single writer
+  void drainOnSignal();
+  // the time for the write syscall profile
+  static uint64_t now();
+
+  int m_fd;
+  char *m_ring;
+  size_t m_capacity;
+  // total bytes ever produced and consumed, the index in the ring is the
+  // position masked by the capacity
+  std::atomic<uint64_t> m_head;
+  std::atomic<uint64_t> m_tail;
+  std::atomic<bool> m_running;
+  // set by the writer thread around each write and by a signal handler that
+  // writes the rest of the ring itself, only one of them ever writes
+  std::atomic<bool> m_writing;
+  std::atomic<bool> m_killed;
+  // set by either side right before it sleeps so the other side knows to
+  // wake it up, both also wake up on their own after a short timeout
+  std::atomic<bool> m_writerWaiting;
+  std::atomic<bool> m_producerWaiting;
+  std::mutex m_mutex;
+  std::condition_variable m_writerCond;
+  std::condition_variable m_producerCond;
+  std::thread m_thread;
+
+  // producer-side stats
+  size_t m_highWater;
+  uint64_t m_numStalls;
+  // writer-side stats
+  std::atomic<uint64_t> m_numSyscalls;
+  LatencyHistogram *m_profile;
+};
@@ -0,0 +1,108 @@
+#include "PeriodDetector.h"
+
+#include "Colors/ColorTypes.h"
+
+#include <string.h>
+
+// how many times a cycle has to repeat before it's believed
+#define MIN_CYCLES 3
+
+// the fewest frames a cycle has to hold for, so a pattern that is blank for a
+// while between flashes isn't mistaken for one that is blank forever
+#define MIN_WINDOW 4096
+
+PeriodDetector::PeriodDetector() :
+  m_numLeds(0),
+  m_frames(nullptr),
+  m_hashes(nullptr),
+  m_latest(0),
+  m_count(0)
+{
+}
+
+PeriodDetector::~PeriodDetector()
+{
+  cleanup();
+}
+
+bool PeriodDetector::init(uint32_t numLeds)
+{
+  cleanup();
+  m_numLeds = numLeds;
+  m_frames = new RGBColor[(size_t)HISTORY * m_numLeds];
+  m_hashes = new uint64_t[HISTORY];
+  return true;
+}
+
+void PeriodDetector::cleanup()
+{
+  delete[] m_frames;
+  delete[] m_hashes;
+  m_frames = nullptr;
+  m_hashes = nullptr;
+  m_latest = 0;
+  m_count = 0;
+}
+
+void PeriodDetector::record(const RGBColor *leds)
+{
+  if (!m_frames) {
+    return;
+  }
+  m_latest = (m_latest + 1) % HISTORY;
+  if (m_count < HISTORY) {
+    m_count++;
+  }
+  size_t len = m_numLeds * sizeof(RGBColor);
+  memcpy(m_frames + ((size_t)m_latest * m_numLeds), leds, len);
+  // FNV-1a over the bytes of the frame
+  const uint8_t *bytes = (const uint8_t *)leds;
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < len; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  m_hashes[m_latest] = hash;
+}
+
+uint32_t PeriodDetector::period() const
+{
+  size_t len = m_numLeds * sizeof(RGBColor);
+  for (uint32_t p = 1; p <= MAX_PERIOD; ++p) {
+    uint32_t window = p * MIN_CYCLES;
+    if (window < MIN_WINDOW) {
+      window = MIN_WINDOW;
+    }
+    if (window + p > m_count) {
+      // the longer periods need even more frames
+      break;
+    }
+    uint32_t i = 0;
+    while (i < window && m_hashes[slot(i)] == m_hashes[slot(i + p)]) {
+      i++;
+    }
+    if (i < window) {
+      continue;
+    }
+    // make sure it wasn't a collision before trusting it
+    for (i = 0; i < p; ++i) {
+      if (memcmp(frame(i), frame(i + p), len) != 0) {
+        break;
+      }
+    }
+    if (i == p) {
+      return p;
+    }
+  }
+  return 0;
+}
+
+const RGBColor *PeriodDetector::predict(uint32_t ahead, uint32_t period) const
+{
+  // the same point of the cycle but at or before the latest frame
+  return frame((period - (ahead % period)) % period);
+}
+
+const RGBColor *PeriodDetector::frame(uint32_t back) const
+{
+  return m_frames + ((size_t)slot(back) * m_numLeds);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+class RGBColor;
+
+// This keeps a ring of the most recent frames along with a hash of each one
+// and finds when the output has settled into an exact cycle. The hashes are
+// compared first so looking for a period is cheap when there isn't one, then
+// the frames of the last cycle are compared for real before it's trusted.
+// Once there is a period any number of frames after the latest one can be
+// predicted by indexing into the last cycle
+
+class PeriodDetector
+{
+public:
+  PeriodDetector();
+  ~PeriodDetector();
+
+  bool init(uint32_t numLeds);
+  void cleanup();
+
+  // add the latest frame
+  void record(const RGBColor *leds);
+
+  // the shortest period that the recent frames have been repeating with for
+  // at least a few cycles and a minimum number of frames, 0 if there is none
+  uint32_t period() const;
+
+  // the frame that comes some number of frames (from 1) after the latest one
+  // if the output keeps repeating with a period
+  const RGBColor *predict(uint32_t ahead, uint32_t period) const;
+
+  // the longest period that can be found
+  static const uint32_t MAX_PERIOD = 2048;
+
+private:
+  // the frame that was recorded some number of frames before the latest
+  uint32_t slot(uint32_t back) const { return (m_latest + HISTORY - back) % HISTORY; }
+  const RGBColor *frame(uint32_t back) const;
+
+  // how many frames are kept, enough for a few cycles of the longest period
+  static const uint32_t HISTORY = 8192;
+
+  uint32_t m_numLeds;
+  RGBColor *m_frames;
+  uint64_t *m_hashes;
+  // the slot of the latest frame and how many have been recorded
+  uint32_t m_latest;
+  uint32_t m_count;
+};
@@ -0,0 +1,66 @@
+#include "RuntimeMetrics.h"
+#include "TickProfiler.h"
+
+#include <unistd.h>
+#include <stdio.h>
+
+using namespace std;
+
+RuntimeMetrics::RuntimeMetrics() :
+  m_start(TickProfiler::now()),
+  m_ticks(0),
+  m_frames(0),
+  m_commands(0),
+  m_buttonEvents(0),
+  m_storageSaves(0),
+  m_maxTickTime(0)
+{
+}
+
+size_t RuntimeMetrics::format(char *buf, size_t size, uint64_t bytesWritten) const
+{
+  int len = snprintf(buf, size,
+    "uptime_seconds %.3f\n"
+    "ticks %" PRIu64 "\n"
+    "frames %" PRIu64 "\n"
+    "bytes_written %" PRIu64 "\n"
+    "input_commands %" PRIu64 "\n"
+    "button_events %" PRIu64 "\n"
+    "storage_saves %" PRIu64 "\n"
+    "max_tick_ns %" PRIu64 "\n"
+    "rss_bytes %" PRIu64 "\n",
+    (TickProfiler::now() - m_start) / 1000000000.0,
+    m_ticks.load(memory_order_relaxed),
+    m_frames.load(memory_order_relaxed),
+    bytesWritten,
+    m_commands.load(memory_order_relaxed),
+    m_buttonEvents.load(memory_order_relaxed),
+    m_storageSaves.load(memory_order_relaxed),
+    m_maxTickTime.load(memory_order_relaxed),
+    residentBytes());
+  if (len < 0) {
+    return 0;
+  }
+  return ((size_t)len < size) ? (size_t)len : size - 1;
+}
+
+uint64_t RuntimeMetrics::residentBytes()
+{
+#ifndef WASM
+  // the second number of statm is the resident pages
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (!statm) {
+    return 0;
+  }
+  unsigned long long size = 0;
+  unsigned long long resident = 0;
+  int found = fscanf(statm, "%llu %llu", &size, &resident);
+  fclose(statm);
+  if (found != 2) {
+    return 0;
+  }
+  return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
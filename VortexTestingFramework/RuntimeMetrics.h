@@ -0,0 +1,48 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <atomic>
+
+// These are the counters of a running instance that can be looked at from
+// outside while it runs (SIGUSR1 or the --metrics-socket). The tick thread is
+// the only writer and every update is a relaxed atomic so counting costs next
+// to nothing, the readers only need each value on its own to be sane
+
+class RuntimeMetrics
+{
+public:
+  RuntimeMetrics();
+
+  // tick thread: count a tick and how long it took
+  void recordTick(uint64_t ns) {
+    m_ticks.store(m_ticks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (ns > m_maxTickTime.load(std::memory_order_relaxed)) {
+      m_maxTickTime.store(ns, std::memory_order_relaxed);
+    }
+  }
+  void addFrames(uint64_t count) { add(m_frames, count); }
+  void addCommands(uint64_t count) { add(m_commands, count); }
+  void addButtonEvent() { add(m_buttonEvents, 1); }
+  void addStorageSaves(uint64_t count) { add(m_storageSaves, count); }
+
+  // any thread: write the counters as lines of "name value", along with the
+  // bytes written which the output writers keep track of themselves
+  size_t format(char *buf, size_t size, uint64_t bytesWritten) const;
+
+private:
+  static void add(std::atomic<uint64_t> &counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+  // the resident memory of the process from /proc
+  static uint64_t residentBytes();
+
+  uint64_t m_start;
+  std::atomic<uint64_t> m_ticks;
+  std::atomic<uint64_t> m_frames;
+  std::atomic<uint64_t> m_commands;
+  std::atomic<uint64_t> m_buttonEvents;
+  std::atomic<uint64_t> m_storageSaves;
+  std::atomic<uint64_t> m_maxTickTime;
+};
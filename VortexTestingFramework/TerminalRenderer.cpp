@@ -0,0 +1,350 @@
+#include "TerminalRenderer.h"
+
+#include "Colors/ColorTypes.h"
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <math.h>
+
+// the terminal size to assume when stdout isn't a terminal
+#define DEFAULT_WIDTH 80
+// the widest box that will be drawn
+#define MAX_WIDTH 1000
+
+// how many pixels of the windows framework make up a row of the terminal, a
+// column is narrower so the leds keep roughly the same shape on screen
+#define DEVICE_PX_PER_ROW 10.0f
+#define DEVICE_PX_PER_CELL 16.0f
+
+volatile sig_atomic_t TerminalRenderer::m_resized = 1;
+
+TerminalRenderer::TerminalRenderer() :
+  m_encoder(),
+  m_numLeds(0),
+  m_hexCells(false),
+  m_cellWidth(4),
+  m_layout(LAYOUT_STRIP),
+  m_usage(nullptr),
+  m_usageBrief(nullptr),
+  m_numUsage(0),
+  m_width(0),
+  m_boxWidth(0),
+  m_boxRows(1),
+  m_ledRows(nullptr),
+  m_ledCols(nullptr),
+  m_shown(nullptr),
+  m_needStatic(true),
+  m_hud()
+{
+}
+
+TerminalRenderer::~TerminalRenderer()
+{
+  cleanup();
+}
+
+bool TerminalRenderer::init(uint32_t numLeds, bool hexCells, Layout layout,
+  const char **usage, const char **usageBrief, uint32_t numUsage)
+{
+  cleanup();
+  m_numLeds = numLeds;
+  m_hexCells = hexCells;
+  // a hex cell is the 6 digits, a color cell is [  ]
+  m_cellWidth = hexCells ? FrameEncoder::hexBytes : 4;
+  m_layout = layout;
+  m_usage = usage;
+  m_usageBrief = usageBrief;
+  m_numUsage = numUsage;
+  m_ledRows = new uint32_t[numLeds];
+  m_ledCols = new uint32_t[numLeds];
+  m_shown = new uint32_t[numLeds];
+  // catch resizes instead of asking the terminal for its size every frame
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onResize;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGWINCH, &sa, nullptr);
+  m_resized = 1;
+  return true;
+}
+
+void TerminalRenderer::cleanup()
+{
+  if (m_ledRows) {
+    delete[] m_ledRows;
+    m_ledRows = nullptr;
+  }
+  if (m_ledCols) {
+    delete[] m_ledCols;
+    m_ledCols = nullptr;
+  }
+  if (m_shown) {
+    delete[] m_shown;
+    m_shown = nullptr;
+  }
+  m_encoder.cleanup();
+  m_numLeds = 0;
+}
+
+void TerminalRenderer::draw(const RGBColor *leds)
+{
+  if (m_resized) {
+    updateSize();
+  }
+  m_encoder.clear();
+  if (m_needStatic) {
+    drawStatic(leds);
+    return;
+  }
+  bool changed = false;
+  for (uint32_t i = 0; i < m_numLeds; ++i) {
+    if (m_shown[i] != leds[i].raw()) {
+      drawLed(leds, i);
+      changed = true;
+    }
+  }
+  if (changed) {
+    // park the cursor under the usage so any other output lands there
+    moveTo(m_boxRows + m_numUsage + 4, 1);
+  }
+}
+
+void TerminalRenderer::finish()
+{
+  m_encoder.clear();
+  moveTo(m_boxRows + m_numUsage + 4, 1);
+  m_encoder.append("\33[?25h");
+}
+
+void TerminalRenderer::drawHud(const char *text)
+{
+  strncpy(m_hud, text, sizeof(m_hud) - 1);
+  m_hud[sizeof(m_hud) - 1] = '\0';
+  m_encoder.clear();
+  if (m_needStatic) {
+    // the line goes out with the rest of the screen
+    return;
+  }
+  moveTo(m_boxRows + 3, 1);
+  drawHudLine();
+  moveTo(m_boxRows + m_numUsage + 4, 1);
+}
+
+void TerminalRenderer::onResize(int sig)
+{
+  m_resized = 1;
+}
+
+void TerminalRenderer::updateSize()
+{
+  m_resized = 0;
+  struct winsize size;
+  memset(&size, 0, sizeof(size));
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) != 0 || !size.ws_col) {
+    size.ws_col = DEFAULT_WIDTH;
+  }
+  m_width = (size.ws_col > MAX_WIDTH) ? MAX_WIDTH : size.ws_col;
+  if (m_layout == LAYOUT_DEVICE) {
+    layoutDevice();
+  } else {
+    layoutStrip();
+  }
+  // only a resize can grow the static parts so only reallocate here
+  size_t extra = ((m_boxRows + 3) * (m_boxWidth + 16)) + (m_numUsage * (m_width + 16)) + 64;
+  m_encoder.init(m_numLeds, extra + ((size_t)m_numLeds * 16));
+  m_needStatic = true;
+}
+
+void TerminalRenderer::layoutStrip()
+{
+  // |----=[leds]=----| centered in the box
+  uint32_t stripWidth = m_numLeds * m_cellWidth;
+  m_boxWidth = m_width;
+  if (m_boxWidth < stripWidth + 4) {
+    m_boxWidth = stripWidth + 4;
+  }
+  m_boxRows = 1;
+  uint32_t left = 2 + ((m_boxWidth - (stripWidth + 4)) / 2) + 1;
+  for (uint32_t i = 0; i < m_numLeds; ++i) {
+    m_ledRows[i] = 2;
+    m_ledCols[i] = left + (i * m_cellWidth);
+  }
+}
+
+void TerminalRenderer::layoutDevice()
+{
+  // these are the same positions that the windows framework uses in
+  // the TestFramework::setupLedPositions* functions
+  float *xs = new float[m_numLeds];
+  float *ys = new float[m_numLeds];
+  bool known = true;
+  switch (m_numLeds) {
+  case 28: // orbit
+    for (uint32_t i = 0; i < 3; ++i) {
+      xs[i] = 150 + (i * 17);       ys[i] = 181 + (i * 17);
+      xs[6 - i] = 332 - (i * 17);   ys[6 - i] = 181 + (i * 17);
+      xs[7 + i] = 400 + (i * 17);   ys[7 + i] = 181 + (i * 17);
+      xs[13 - i] = 82 - (i * 17);   ys[13 - i] = 181 + (i * 17);
+      xs[14 + i] = 82 - (i * 17);   ys[14 + i] = 113 - (i * 17);
+      xs[20 - i] = 400 + (i * 17);  ys[20 - i] = 113 - (i * 17);
+      xs[21 + i] = 332 - (i * 17);  ys[21 + i] = 113 - (i * 17);
+      xs[27 - i] = 150 + (i * 17);  ys[27 - i] = 113 - (i * 17);
+    }
+    xs[3] = xs[2] + 25;   ys[3] = ys[2] + 25;
+    xs[10] = xs[11] - 25; ys[10] = ys[11] + 25;
+    xs[17] = xs[16] - 25; ys[17] = ys[16] - 25;
+    xs[24] = xs[25] + 25; ys[24] = ys[25] - 25;
+    break;
+  case 20: // chromadeck
+    for (uint32_t i = 0; i < m_numLeds; ++i) {
+      float radius = (i < (m_numLeds / 2)) ? 140 : 110;
+      float angle = i * ((2.0f * M_PI) / (m_numLeds / 2));
+      xs[i] = 150 + radius * cos(angle - (M_PI / 2.0f));
+      ys[i] = 170 + radius * sin(angle - (M_PI / 2.0f));
+    }
+    break;
+  case 10: // glove
+    xs[0] = 95;  ys[0] = 175; xs[1] = 75;  ys[1] = 155;
+    xs[2] = 135; ys[2] = 60;  xs[3] = 127; ys[3] = 30;
+    xs[4] = 195; ys[4] = 40;  xs[5] = 195; ys[5] = 10;
+    xs[6] = 254; ys[6] = 60;  xs[7] = 262; ys[7] = 30;
+    xs[8] = 300; ys[8] = 95;  xs[9] = 316; ys[9] = 73;
+    break;
+  case 6: // spark
+    for (uint32_t i = 0; i < m_numLeds; ++i) {
+      float angle = i * ((2.0f * M_PI) / m_numLeds);
+      xs[i] = 150 + 120 * cos(-angle - (M_PI / 2.0f));
+      ys[i] = 150 + 120 * sin(-angle - (M_PI / 2.0f));
+    }
+    break;
+  case 3: // handle
+    xs[0] = 165; ys[0] = 95;
+    xs[1] = 112; ys[1] = 178;
+    xs[2] = 186; ys[2] = 230;
+    break;
+  case 2: // duo
+    xs[0] = 196; ys[0] = 18;
+    xs[1] = 196; ys[1] = 38;
+    break;
+  default:
+    known = false;
+    break;
+  }
+  if (!known) {
+    delete[] xs;
+    delete[] ys;
+    layoutStrip();
+    return;
+  }
+  float minX = xs[0];
+  float minY = ys[0];
+  for (uint32_t i = 1; i < m_numLeds; ++i) {
+    minX = fminf(minX, xs[i]);
+    minY = fminf(minY, ys[i]);
+  }
+  // scale the pixels down to cells with a margin of 2 inside the box
+  float pxPerCol = DEVICE_PX_PER_CELL / m_cellWidth;
+  uint32_t maxCol = 0;
+  m_boxRows = 0;
+  for (uint32_t i = 0; i < m_numLeds; ++i) {
+    m_ledRows[i] = (uint32_t)((ys[i] - minY) / DEVICE_PX_PER_ROW);
+    m_ledCols[i] = (uint32_t)((xs[i] - minX) / pxPerCol);
+    if (m_ledRows[i] + 1 > m_boxRows) {
+      m_boxRows = m_ledRows[i] + 1;
+    }
+    if (m_ledCols[i] + m_cellWidth > maxCol) {
+      maxCol = m_ledCols[i] + m_cellWidth;
+    }
+  }
+  delete[] xs;
+  delete[] ys;
+  m_boxWidth = m_width;
+  if (m_boxWidth < maxCol + 6) {
+    m_boxWidth = maxCol + 6;
+  }
+  uint32_t left = 2 + ((m_boxWidth - maxCol - 2) / 2);
+  for (uint32_t i = 0; i < m_numLeds; ++i) {
+    m_ledRows[i] += 2;
+    m_ledCols[i] += left;
+  }
+}
+
+void TerminalRenderer::drawStatic(const RGBColor *leds)
+{
+  // clear the screen, home the cursor and hide it
+  m_encoder.append("\33[2J\33[H\33[?25l");
+  // the top border
+  m_encoder.append('+');
+  m_encoder.appendRepeat('-', m_boxWidth - 2);
+  m_encoder.append("+\n");
+  // the inside of the box
+  for (uint32_t r = 0; r < m_boxRows; ++r) {
+    m_encoder.append('|');
+    if (m_layout == LAYOUT_STRIP || !m_numLeds) {
+      // |----=          =----|
+      uint32_t pad = m_ledCols[0] - 3;
+      uint32_t strip = m_numLeds * m_cellWidth;
+      m_encoder.appendRepeat('-', pad);
+      m_encoder.append('=');
+      m_encoder.appendRepeat(' ', strip);
+      m_encoder.append('=');
+      m_encoder.appendRepeat('-', m_boxWidth - (pad + strip + 4));
+    } else {
+      m_encoder.appendRepeat(' ', m_boxWidth - 2);
+    }
+    m_encoder.append("|\n");
+  }
+  // the bottom border and a gap before the usage where the hud goes
+  m_encoder.append('+');
+  m_encoder.appendRepeat('-', m_boxWidth - 2);
+  m_encoder.append("+\n");
+  drawHudLine();
+  for (uint32_t i = 0; i < m_numUsage; ++i) {
+    const char *line = (m_width < 70) ? m_usageBrief[i] : m_usage[i];
+    // the usage lines all start with a newline
+    m_encoder.append("\n");
+    m_encoder.append(line + 1);
+  }
+  for (uint32_t i = 0; i < m_numLeds; ++i) {
+    drawLed(leds, i);
+  }
+  moveTo(m_boxRows + m_numUsage + 4, 1);
+  m_needStatic = false;
+}
+
+void TerminalRenderer::drawLed(const RGBColor *leds, uint32_t index)
+{
+  moveTo(m_ledRows[index], m_ledCols[index]);
+  if (m_hexCells) {
+    m_encoder.appendHex(leds + index, 1);
+  } else {
+    m_encoder.appendColor(leds + index, 1);
+  }
+  m_shown[index] = leds[index].raw();
+}
+
+void TerminalRenderer::drawHudLine()
+{
+  if (!m_hud[0]) {
+    return;
+  }
+  size_t len = strlen(m_hud);
+  if (len > m_width) {
+    len = m_width;
+  }
+  m_encoder.append(m_hud, len);
+  // clear whatever was left of a longer line
+  m_encoder.append("\33[K");
+}
+
+void TerminalRenderer::moveTo(uint32_t row, uint32_t col)
+{
+  m_encoder.append("\33[");
+  m_encoder.appendNumber(row);
+  m_encoder.append(';');
+  m_encoder.appendNumber(col);
+  m_encoder.append('H');
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <signal.h>
+
+#include "FrameEncoder.h"
+
+class RGBColor;
+class ColorPalette;
+
+// This draws the in-place (interactive) output. The box, borders and usage are
+// only drawn once and again whenever the terminal is resized, after that each
+// frame only moves the cursor to the leds that changed color and redraws those
+
+class TerminalRenderer
+{
+public:
+  TerminalRenderer();
+  ~TerminalRenderer();
+
+  enum Layout {
+    // all of the leds in one row like the original in-place output
+    LAYOUT_STRIP,
+    // the leds placed like they are on the device in the windows framework
+    LAYOUT_DEVICE,
+  };
+
+  // setup for a number of leds, the usage lines are printed under the box
+  bool init(uint32_t numLeds, bool hexCells, Layout layout,
+    const char **usage, const char **usageBrief, uint32_t numUsage);
+  void cleanup();
+
+  // draw color cells with a 256 or 16 color palette
+  void setPalette(const ColorPalette *palette) { m_encoder.setPalette(palette); }
+
+  // build the output for a frame of leds, only what changed is included
+  void draw(const RGBColor *leds);
+  // build the output that moves the cursor below the box and shows it again
+  void finish();
+  // build the output for a status line in the gap between the box and the
+  // usage, it's cut to the width of the terminal and kept for redraws
+  void drawHud(const char *text);
+
+  // the output built by the last draw or finish
+  const char *data() const { return m_encoder.data(); }
+  size_t size() const { return m_encoder.size(); }
+
+private:
+  // the SIGWINCH handler only flags the size as stale
+  static void onResize(int sig);
+  static volatile sig_atomic_t m_resized;
+
+  // re-read the terminal size and work out where everything goes
+  void updateSize();
+  void layoutStrip();
+  void layoutDevice();
+  // draw the static parts of the screen and every led
+  void drawStatic(const RGBColor *leds);
+  // draw a single led cell at its position
+  void drawLed(const RGBColor *leds, uint32_t index);
+  // the hud at the cursor
+  void drawHudLine();
+  void moveTo(uint32_t row, uint32_t col);
+
+  FrameEncoder m_encoder;
+  uint32_t m_numLeds;
+  bool m_hexCells;
+  uint32_t m_cellWidth;
+  Layout m_layout;
+  const char **m_usage;
+  const char **m_usageBrief;
+  uint32_t m_numUsage;
+
+  // the cached terminal width
+  uint32_t m_width;
+  // the size of the box and the rows inside of it
+  uint32_t m_boxWidth;
+  uint32_t m_boxRows;
+  // the 1-based screen row and column of each led
+  uint32_t *m_ledRows;
+  uint32_t *m_ledCols;
+  // the colors currently on the screen and whether they can be trusted
+  uint32_t *m_shown;
+  bool m_needStatic;
+  // the last status line
+  char m_hud[256];
+};
@@ -4,7 +4,11 @@
 #include <iomanip>
 #include <string>
 #include <ctime>
+#include <chrono>
 #include <map>
+#include <vector>
+
+#include <inttypes.h>
 
 #include <sys/ioctl.h>
 #include <termios.h>
@@ -14,6 +18,20 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <errno.h>
+#include <ctype.h>
+#include <poll.h>
+#ifndef WASM
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <sys/inotify.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <time.h>
 
 #include "TestFrameworkLinux.h"
 
@@ -27,6 +45,7 @@
 #include "Colors/Colorset.h"
 #include "Buttons/Button.h"
 #include "Time/Timings.h"
+#include "VortexEngine.h"
 #include "Menus/Menus.h"
 #include "Modes/Modes.h"
 #include "Modes/Mode.h"
@@ -36,6 +55,96 @@
 
 #define RECORD_FILE "recorded_input.txt"
 
+// how many times per second the in-place output is redrawn by default
+#define DEFAULT_RENDER_FPS 60
+
+// how much output the terminal can be holding before in-place redraws are
+// skipped until it catches up
+#define RENDER_BACKLOG_BYTES 1024
+
+// how often the --hud line is updated, slow enough that drawing it doesn't
+// change what it's measuring
+#define HUD_INTERVAL_MS 500
+
+// how often the metrics that need a syscall or a copy of the command log are
+// brought up to date, and how long the metrics socket waits between checks
+// for the framework shutting down
+#define METRICS_POLL_INTERVAL (1000 * 1000000ull)
+#define METRICS_ACCEPT_TIMEOUT_MS 200
+// enough for every line of the metrics
+#define METRICS_TEXT_SIZE 1024
+
+#ifndef WASM
+// set by SIGUSR1 and picked up by the tick thread
+static volatile sig_atomic_t g_metricsRequested = 0;
+
+static void onMetricsSignal(int sig)
+{
+  g_metricsRequested = 1;
+}
+#endif
+
+// the size of the ring between show() and the output writer thread
+#define OUTPUT_RING_SIZE (1024 * 1024)
+
+// how much input is read from a descriptor at a time
+#define INPUT_CHUNK_SIZE 4096
+
+// how far the ticks can fall behind before the missed ones are dropped
+// instead of being run back to back to catch up
+#define TICK_CATCHUP_LIMIT (100 * 1000000ull)
+
+// the priority the tick loop asks for with --priority, a realtime priority
+// above the lowest or if that isn't allowed a nice value
+#define TICK_PRIORITY 10
+#define TICK_NICE -10
+
+// the range of the --speed factor and the keys that change it at runtime
+#define MIN_SPEED (1.0 / 64)
+#define MAX_SPEED 64.0
+#define SPEED_UP_KEY '+'
+#define SPEED_DOWN_KEY '-'
+
+// the input commands that each take one tick of the engine (times the count
+// that follows them) and the shortest wait that --fast-forward looks into
+#define TICK_COMMANDS "clmadsftrwq"
+#define MIN_FAST_FORWARD_WAIT 256
+
+// how many ticks an --until is given to be met by default, almost three hours
+// of engine time which is a few seconds with --no-timestep
+#define DEFAULT_UNTIL_MAX 10000000
+
+// the --script or --input-file is handed to the engine a chunk at a time
+// whenever it has fewer than this many ticks of commands left to get through
+#define FEED_BACKLOG 1024
+// the engine only takes single digit counts when it's interactive
+#define IN_PLACE_MAX_REPEAT 9
+// an interactive --until keeps the feed only just ahead of the engine so
+// there's next to nothing left for it to play out when stdin takes over
+#define HANDOVER_CHUNK_SIZE 32
+// how many ticks of a wait go by between looking for a period
+#define PERIOD_CHECK_INTERVAL 64
+
+// the names of the input commands in the --trace timeline
+static const char *commandName(char command)
+{
+  switch (command) {
+  case 'c': return "short click";
+  case 'l': return "long click";
+  case 'm': return "menus click";
+  case 'a': return "adv menu click";
+  case 'd': return "delete click";
+  case 's': return "sleep click";
+  case 'f': return "force sleep click";
+  case 't': return "toggle";
+  case 'r': return "rapid click";
+  case 'w': return "wait";
+  case 'q': return "quit";
+  default: break;
+  }
+  return "input";
+}
+
 TestFramework *g_pTestFramework = nullptr;
 
 using namespace std;
@@ -52,6 +161,7 @@ const char *input_usage[] = {
   "\n   t         toggle button pressed (only way to wake after sleep)",
   "\n   r         rapid button click (ex: r15)",
   "\n   w         wait 1 tick",
+  "\n   + -       double or halve the --speed (not sent to the engine)",
   "\n   <digits>  repeat command n times (only single digits in -i mode)",
   "\n   q         quit",
 };
@@ -70,40 +180,12 @@ const char *input_usage_brief[NUM_USAGE] = {
   "\n   t         toggle",
   "\n   r         rapid",
   "\n   w         wait",
+  "\n   + -       speed",
   "\n   <digits>  repeat",
   "\n   q         quit",
 };
 
 
-// 1000 spaces, used for efficiently printing any number of spaces up to 1000 by
-// offsetting from the start of this string with the SPACES() macro below
-#define SPACESTR "                                                                                                                                                     " \
-                 "                                                                                                                                                     " \
-                 "                                                                                                                                                     " \
-                 "                                                                                                                                                     " \
-                 "                                                                                                                                                     " \
-                 "                                                                                                                                                     " \
-                 "                                                                                                                                                     " \
-                 "                                                                                                                                                     " \
-                 "                                                                                                                                                     " \
-                 "                                                                                                                                                     "
-
-// 1000 hyphens for a long line
-#define LINESTR  "-----------------------------------------------------------------------------------------------------------------------------------------------------" \
-                 "-----------------------------------------------------------------------------------------------------------------------------------------------------" \
-                 "-----------------------------------------------------------------------------------------------------------------------------------------------------" \
-                 "-----------------------------------------------------------------------------------------------------------------------------------------------------" \
-                 "-----------------------------------------------------------------------------------------------------------------------------------------------------" \
-                 "-----------------------------------------------------------------------------------------------------------------------------------------------------" \
-                 "-----------------------------------------------------------------------------------------------------------------------------------------------------" \
-                 "-----------------------------------------------------------------------------------------------------------------------------------------------------" \
-                 "-----------------------------------------------------------------------------------------------------------------------------------------------------"
-
-// some amount of spaces, if you pass in an amount greater than 1000 you will die
-#define SPACES(amt) SPACESTR + (sizeof(SPACESTR) - (amt))
-// some length of line, if you pass in an amount greater than 1000 you will die
-#define LINE(amt) LINESTR + (sizeof(LINESTR) - (amt))
-
 #ifdef WASM // Web assembly glue
 #include <emscripten/html5.h>
 #include <emscripten.h>
@@ -144,9 +226,11 @@ TestFramework::TestFramework() :
   m_curPattern(PATTERN_FIRST),
   m_curColorset(),
   m_outputType(OUTPUT_TYPE_NONE),
+  m_binaryFormat(BINARY_FORMAT_FRAMES),
   m_noTimestep(false),
   m_lockstep(false),
   m_inPlace(false),
+  m_repeatFrames(false),
   m_record(false),
   m_storage(false),
   m_sleepEnabled(true),
@@ -155,29 +239,188 @@ TestFramework::TestFramework() :
   m_patternIDStr(),
   m_colorsetStr(),
   m_argumentsStr(),
+  m_colorModeStr("auto"),
+  m_outputFile(),
   m_pipe_fd{-1, -1},
-  m_saved_stdin(),
-  m_inputBuffer()
+  m_saved_stdin(-1),
+  m_readStdin(false),
+  m_inputBuffer(),
+  m_encoder(),
+  m_palette(),
+  m_lastFrame(nullptr),
+  m_repeatCount(0),
+  m_frameCount(0),
+  m_framesKept(0),
+  m_filterFrames(false),
+  m_every(1),
+  m_fromTick(0),
+  m_toTick(UINT32_MAX),
+  m_atTicks(),
+  m_nextAtTick(0),
+  m_headless(false),
+  m_captureFrames(false),
+  m_maxTicks(0),
+  m_frames(),
+  m_framesCallback(nullptr),
+  m_framesArg(nullptr),
+  m_headlessTime(0),
+  m_until(),
+  m_untilExpr(),
+  m_untilAction(UNTIL_STOP),
+  m_untilMax(DEFAULT_UNTIL_MAX),
+  m_untilWatching(false),
+  m_untilMet(false),
+  m_untilCount(0),
+  m_untilStop(false),
+  m_untilInteractive(false),
+  m_exitCode(EXIT_SUCCESS),
+  m_tickShowed(true),
+  m_idleWaits(0),
+  m_idleTime(0),
+#ifndef WASM
+  m_reactor(),
+#endif
+  m_useReactor(false),
+  m_inputArrived(false),
+  m_tickPeriod(0),
+  m_nextTick(0),
+  m_tickrate(0),
+  m_priority(false),
+  m_speed(1.0),
+  m_baseTickPeriod(0),
+  m_fastForward(false),
+  m_ffInput(),
+  m_ffInputDone(false),
+  m_ffBacklog(0),
+  m_ffWait(0),
+  m_ffCheckIn(0),
+  m_periods(),
+  m_ffTicks(0),
+  m_ffSkips(0),
+  m_script(),
+  m_scriptFile(),
+  m_inputFile(),
+  m_inputFileName(),
+  m_feedBacklog(0),
+  m_recording(),
+  m_recordingFile(),
+  m_recordFile(RECORD_FILE),
+  m_recordLog(),
+  m_passthrough(false),
+  m_replay(),
+  m_replayFile(),
+  m_profiling(false),
+  m_profileJson(false),
+  m_profiler(),
+  m_showTime(0),
+  m_traceFile(),
+  m_trace(),
+  m_traceLeds(nullptr),
+  m_tracePressed(false),
+  m_traceArgs(),
+  m_tickLateness(),
+  m_tickOverruns(0),
+  m_ticksSkipped(0),
+  m_controlPath(),
+  m_controlFd(-1),
+  m_irPath(),
+  m_irListenFd(-1),
+  m_irFd(-1),
+  m_irBuffer(),
+  m_serialPath(),
+  m_serialFd(-1),
+  m_serialBuffer(),
+  m_snapshot(),
+  m_renderThread(),
+  m_rendering(false),
+  m_renderFps(DEFAULT_RENDER_FPS),
+  m_output(),
+  m_fileOutput(),
+  m_sink(),
+  m_outputStats(false),
+  m_framesRendered(0),
+  m_framesDropped(0),
+  m_framesSkipped(0),
+  m_backedUpRenders(0),
+  m_lastRenderedFrame(0),
+  m_heldFrame(0),
+  m_publishedFrame(0),
+  m_hud(false),
+  m_hudSleeping(false),
+  m_hudTicks(0),
+  m_hudPending(0),
+  m_hudTarget(0),
+  m_metrics(),
+  m_metricsPressed(false),
+  m_nextMetricsPoll(0),
+  m_metricsPath(),
+  m_metricsFd(-1),
+  m_metricsThread(),
+  m_metricsServing(false),
+  m_storageWatchFd(-1),
+  m_storageName(),
+  m_terminal(),
+  m_layout(TerminalRenderer::LAYOUT_STRIP)
 {
 }
 
 TestFramework::~TestFramework()
 {
+  if (m_lastFrame) {
+    delete[] m_lastFrame;
+  }
+  if (m_traceLeds) {
+    delete[] m_traceLeds;
+  }
 }
 
 static struct option long_options[] = {
   {"hex", no_argument, nullptr, 'x'},
   {"color", no_argument, nullptr, 'c'},
+  {"color-mode", required_argument, nullptr, 'm'},
+  {"binary", optional_argument, nullptr, 'b'},
+  {"null", no_argument, nullptr, 'N'},
+  {"output", required_argument, nullptr, 'o'},
   {"no-timestep", no_argument, nullptr, 't'},
   {"lockstep", no_argument, nullptr, 'l'},
   {"in-place", no_argument, nullptr, 'i'},
+  {"fps", required_argument, nullptr, 'F'},
+  {"layout", required_argument, nullptr, 'L'},
+  {"repeat", no_argument, nullptr, 'R'},
+  {"every", required_argument, nullptr, 'E'},
+  {"from-tick", required_argument, nullptr, 'f'},
+  {"to-tick", required_argument, nullptr, 'T'},
+  {"at-ticks", required_argument, nullptr, 'k'},
+  {"frames", required_argument, nullptr, 'H'},
+  {"until-input-exhausted", no_argument, nullptr, 'U'},
+  {"until", required_argument, nullptr, 'G'},
+  {"until-action", required_argument, nullptr, 'g'},
+  {"until-max", required_argument, nullptr, 'Y'},
   {"record", no_argument, nullptr, 'r'},
+  {"record-file", required_argument, nullptr, 'w'},
   {"autowake", no_argument, nullptr, 'a'},
   {"nolock", no_argument, nullptr, 'n'},
   {"storage", optional_argument, nullptr, 's'},
   {"pattern", required_argument, nullptr, 'P'},
   {"colorset", required_argument, nullptr, 'C'},
   {"arguments", required_argument, nullptr, 'A'},
+  {"control", required_argument, nullptr, 'O'},
+  {"ir", required_argument, nullptr, 'I'},
+  {"serial", required_argument, nullptr, 'D'},
+  {"metrics-socket", required_argument, nullptr, 'M'},
+  {"tickrate", required_argument, nullptr, 'z'},
+  {"priority", no_argument, nullptr, 'y'},
+  {"speed", required_argument, nullptr, 'V'},
+  {"fast-forward", no_argument, nullptr, 'W'},
+  {"script", required_argument, nullptr, 'j'},
+  {"input-file", required_argument, nullptr, 'J'},
+  {"record-ticks", required_argument, nullptr, 'K'},
+  {"replay", required_argument, nullptr, 'Q'},
+  {"to-input", required_argument, nullptr, 'X'},
+  {"stats", no_argument, nullptr, 'S'},
+  {"profile", optional_argument, nullptr, 'p'},
+  {"trace", required_argument, nullptr, 'e'},
+  {"hud", no_argument, nullptr, 'u'},
   {"help", no_argument, nullptr, 'h'},
   {nullptr, 0, nullptr, 0}
 };
@@ -212,12 +455,50 @@ static void print_usage(const char* program_name)
   fprintf(stderr, "Output Selection (at least one required):\n");
   fprintf(stderr, "  -x, --hex                Use hex values to represent led colors\n");
   fprintf(stderr, "  -c, --color              Use console color codes to represent led colors\n");
+  fprintf(stderr, "  -m, --color-mode <mode>  Colors used by --color: auto (default), truecolor, 256 or 16,\n");
+  fprintf(stderr, "                           auto only picks one for a terminal and is truecolor otherwise\n");
+  fprintf(stderr, "  -b, --binary [format]    Write packed binary frames, format is frames (default) or events\n");
+  fprintf(stderr, "  -N, --null               Don't output anything, for timing the engine\n");
+  fprintf(stderr, "  -o, --output <file>      Also write the frames to a file in hex (works with -x, -c or -i)\n");
+  fprintf(stderr, "  -R, --repeat             Collapse repeated frames into one line ending in *<count>\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Frame Selection (optional):\n");
+  fprintf(stderr, "  -E, --every <n>          Only output every nth frame\n");
+  fprintf(stderr, "  -f, --from-tick <tick>   Only output the frames from this tick on (ticks start at 0)\n");
+  fprintf(stderr, "  -T, --to-tick <tick>     Only output the frames up to and including this tick\n");
+  fprintf(stderr, "  -k, --at-ticks t1,t2...  Only output the frames of these ticks (csv list)\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Headless Runs (optional):\n");
+  fprintf(stderr, "  -H, --frames <n>         Run n ticks as fast as possible and write all the frames at the end\n");
+  fprintf(stderr, "  -U, --until-input-exhausted\n");
+  fprintf(stderr, "                           Same as --frames but run until the input quits (ends in q)\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Run Until (optional):\n");
+  fprintf(stderr, "  -G, --until <expr>       Check a condition after every tick and stop once it's met (see below)\n");
+  fprintf(stderr, "  -g, --until-action <act> When it's met: stop (default), dump the state and keep going, or interactive\n");
+  fprintf(stderr, "                           to drop the rest of the input and read stdin in real time (a count in an\n");
+  fprintf(stderr, "                           --input-file that already started still runs out, a --script splits them)\n");
+  fprintf(stderr, "  -Y, --until-max <ticks>  Give up if it isn't met within this many ticks (default: %u, 0 for no limit)\n", DEFAULT_UNTIL_MAX);
   fprintf(stderr, "\n");
   fprintf(stderr, "Engine Control Flags (optional):\n");
   fprintf(stderr, "  -t, --no-timestep        Bypass the timestep and run as fast as possible\n");
   fprintf(stderr, "  -l, --lockstep           Only step once each time an input is received\n");
   fprintf(stderr, "  -i, --in-place           Print the output in-place (interactive mode)\n");
-  fprintf(stderr, "  -r, --record             Record the inputs and dump to a file after (" RECORD_FILE ")\n");
+  fprintf(stderr, "  -L, --layout <type>      Layout of the in-place leds: strip (default) or device\n");
+  fprintf(stderr, "  -F, --fps <rate>         Max redraws per second of the in-place output (default: %u)\n", DEFAULT_RENDER_FPS);
+  fprintf(stderr, "  -u, --hud                Show the tick rate, render time, dropped and skipped frames and input under the in-place leds\n");
+  fprintf(stderr, "  -z, --tickrate <hz>      Ticks per second of the engine (see --stats for how well it keeps up)\n");
+  fprintf(stderr, "  -V, --speed <factor>     Run the ticks faster or slower than real time (ex: 4x, 0.25x)\n");
+  fprintf(stderr, "  -W, --fast-forward       Predict long waits once the output repeats instead of ticking them (with -t or -H/-U and -a)\n");
+  fprintf(stderr, "  -j, --script <file>      Play an input script with loops and macros (see below) instead of reading stdin\n");
+  fprintf(stderr, "  -J, --input-file <file>  Read the input commands from a file instead of stdin, a .test file uses its Input= line\n");
+  fprintf(stderr, "  -y, --priority           Run the ticks with elevated (realtime if allowed) scheduling priority\n");
+  fprintf(stderr, "  -r, --record             Stream the inputs to a file as they come in (" RECORD_FILE ")\n");
+  fprintf(stderr, "  -w, --record-file <file> Same as --record but to this file\n");
+  fprintf(stderr, "  -K, --record-ticks <file>\n");
+  fprintf(stderr, "                           Record the inputs along with the tick the engine read each of them on\n");
+  fprintf(stderr, "  -Q, --replay <file>      Replay a --record-ticks recording on exactly the same ticks instead of reading stdin\n");
+  fprintf(stderr, "  -X, --to-input <file>    Print a --record-ticks recording as input commands (for the Input= of a test) and exit\n");
   fprintf(stderr, "  -a, --autowake           Automatically and instantly wake on sleep (disable sleep)\n");
   fprintf(stderr, "  -n, --nolock             Automatically unlock upon locking the chip (disable lock)\n");
   fprintf(stderr, "  -s, --storage [file]     Persistent storage to file (default file: FlashStorage.flash)\n");
@@ -227,7 +508,17 @@ static void print_usage(const char* program_name)
   fprintf(stderr, "  -C, --colorset c1,c2...  Preset the colorset on the first mode (csv list of hex codes or color names)\n");
   fprintf(stderr, "  -A, --arguments a1,a2... Preset the arguments on the first mode (csv list of arguments)\n");
   fprintf(stderr, "\n");
+  fprintf(stderr, "Connections (optional):\n");
+  fprintf(stderr, "  -O, --control <fifo>     Also read input commands from a fifo (created if missing)\n");
+  fprintf(stderr, "  -I, --ir <socket>        Connect IR to another vortex over a unix socket, listens if nobody is there\n");
+  fprintf(stderr, "  -D, --serial <device>    Connect the serial port of the engine to a device or pty\n");
+  fprintf(stderr, "  -M, --metrics-socket <path>\n");
+  fprintf(stderr, "                           Serve the runtime metrics on a unix socket (also dumped to stderr on SIGUSR1)\n");
+  fprintf(stderr, "\n");
   fprintf(stderr, "Other Options:\n");
+  fprintf(stderr, "  -S, --stats              Print output statistics to stderr on exit\n");
+  fprintf(stderr, "  -p, --profile [format]   Print how long each phase of the ticks took to stderr, format is text (default) or json\n");
+  fprintf(stderr, "  -e, --trace <file>       Write a timeline of the ticks, inputs and led changes for Perfetto (chrome trace json)\n");
   fprintf(stderr, "  -h, --help               Display this help message\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "Input Commands (pass to stdin):");
@@ -235,18 +526,37 @@ static void print_usage(const char* program_name)
     fprintf(stderr, "%s", input_usage[i]);
   }
   fprintf(stderr, "\n");
+  fprintf(stderr, "Input Scripts (--script, any count can be more than one digit):\n");
+  fprintf(stderr, "   # ...          comment to the end of the line\n");
+  fprintf(stderr, "   (cw300)x500    loop the commands in brackets 500 times, loops can be nested\n");
+  fprintf(stderr, "   @name { ... }  define a macro (ex: @open { m w100 c3 l })\n");
+  fprintf(stderr, "   @name          play a macro that was defined above\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Until Conditions (--until, combined with && || ! and brackets):\n");
+  fprintf(stderr, "   led[0]==FF0000 the color of an led (== != < <= > >=), on its own it's whether it's lit\n");
+  fprintf(stderr, "   menu==randomizer\n");
+  fprintf(stderr, "                  the open menu (none, randomizer, modesharing, colorselect, ...)\n");
+  fprintf(stderr, "   menu           in the menus at all\n");
+  fprintf(stderr, "   sleeping       the engine is asleep\n");
+  fprintf(stderr, "   pressed        the button is held down\n");
+  fprintf(stderr, "   frame_changed  the leds are different than on the tick before\n");
+  fprintf(stderr, "   tick>=5000     the tick that just ran (ticks start at 0)\n");
+  fprintf(stderr, "\n");
   fprintf(stderr, "Example Usage:\n");
   fprintf(stderr, "   ./vortex -ci\n");
   fprintf(stderr, "   ./vortex -ci -P42 -Ccyan,purple\n");
   fprintf(stderr, "   ./vortex -ct -P0 -Cred,green -A1,2 <<< w10q\n");
+  fprintf(stderr, "   ./vortex -xt -G 'menu==randomizer' -g interactive -j repro.script\n");
 }
 
 struct termios orig_term_attr = {0};
-struct winsize terminal_size = {0};
+int orig_stdin_flags = 0;
 
 static void restore_terminal()
 {
   tcsetattr(STDIN_FILENO, TCSANOW, &orig_term_attr);
+  // the flags are shared with the shell it came from
+  fcntl(STDIN_FILENO, F_SETFL, orig_stdin_flags);
 }
 
 void set_terminal_nonblocking()
@@ -271,24 +581,13 @@ void set_terminal_nonblocking()
 
   // Set the terminal to non-blocking mode
   int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
+  orig_stdin_flags = flags;
   fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
 
   // Register the restore_terminal function to be called at exit
   atexit(restore_terminal);
 }
 
-void TestFramework::get_terminal_size()
-{
-  struct winsize new_terminal_size = { 0 };
-  ioctl(STDOUT_FILENO, TIOCGWINSZ, &new_terminal_size);
-  if (terminal_size.ws_col != new_terminal_size.ws_col) {
-    terminal_size = new_terminal_size;
-    if (m_inPlace && !system("clear")) {
-      // failure but don't care
-    }
-  }
-}
-
 bool TestFramework::init(int argc, char *argv[])
 {
   if (g_pTestFramework) {
@@ -298,7 +597,7 @@ bool TestFramework::init(int argc, char *argv[])
 
   int opt = -1;
   int option_index = 0;
-  while ((opt = getopt_long(argc, argv, "xctliransP:C:A:h", long_options, &option_index)) != -1) {
+  while ((opt = getopt_long(argc, argv, "xcm:b::No:RE:f:T:k:H:UG:g:Y:tliL:F:uz:yV:Wj:J:K:Q:X:rw:ansP:C:A:O:I:D:M:Sp::e:h", long_options, &option_index)) != -1) {
     switch (opt) {
     case 'x':
       // if the user wants pretty colors or hex codes
@@ -308,6 +607,99 @@ bool TestFramework::init(int argc, char *argv[])
       // if the user wants pretty colors
       m_outputType = OUTPUT_TYPE_COLOR;
       break;
+    case 'm':
+      // which colors the color output can use
+      m_colorModeStr = optarg;
+      break;
+    case 'b':
+      // if the user wants packed binary frames or change events
+      m_outputType = OUTPUT_TYPE_BINARY;
+      if (optarg && strcmp(optarg, "events") == 0) {
+        m_binaryFormat = BINARY_FORMAT_EVENTS;
+      } else if (optarg && strcmp(optarg, "frames") != 0) {
+        printf("Unknown binary format: %s\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'N':
+      // if the user wants no output at all
+      m_outputType = OUTPUT_TYPE_NULL;
+      break;
+    case 'o':
+      // if the user wants the frames written to a file
+      m_outputFile = optarg;
+      break;
+    case 'R':
+      // if the user wants repeated frames collapsed into one line
+      m_repeatFrames = true;
+      break;
+    case 'E':
+      // only output every nth frame
+      m_every = strtoul(optarg, nullptr, 10);
+      if (!m_every) {
+        m_every = 1;
+      }
+      m_filterFrames = true;
+      break;
+    case 'f':
+      // only output the frames from this tick on
+      m_fromTick = strtoul(optarg, nullptr, 10);
+      m_filterFrames = true;
+      break;
+    case 'T':
+      // only output the frames up to this tick
+      m_toTick = strtoul(optarg, nullptr, 10);
+      m_filterFrames = true;
+      break;
+    case 'k':
+      // only output the frames of specific ticks
+      {
+        stringstream ss(optarg);
+        string tick;
+        while (getline(ss, tick, ',')) {
+          m_atTicks.push_back(strtoul(tick.c_str(), nullptr, 10));
+        }
+        // the ticks are checked in order as the frames come in
+        sort(m_atTicks.begin(), m_atTicks.end());
+        m_atTicks.erase(unique(m_atTicks.begin(), m_atTicks.end()), m_atTicks.end());
+      }
+      m_filterFrames = true;
+      break;
+    case 'H':
+      // run a fixed number of ticks headless
+      m_headless = true;
+      m_maxTicks = strtoul(optarg, nullptr, 10);
+      break;
+    case 'U':
+      // run headless until the input quits
+      m_headless = true;
+      m_maxTicks = 0;
+      break;
+    case 'G':
+      // run until a condition on the leds and engine is met
+      m_untilExpr = optarg;
+      if (m_untilExpr.empty()) {
+        printf("The --until needs a condition\n");
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'g':
+      // what to do when the until condition is met
+      if (strcmp(optarg, "stop") == 0) {
+        m_untilAction = UNTIL_STOP;
+      } else if (strcmp(optarg, "dump") == 0) {
+        m_untilAction = UNTIL_DUMP;
+      } else if (strcmp(optarg, "interactive") == 0) {
+        m_untilAction = UNTIL_INTERACTIVE;
+      } else {
+        printf("Unknown until action: %s\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'Y':
+      // give up on the until condition after this many ticks
+      m_untilMax = strtoul(optarg, nullptr, 10);
+      break;
     case 't':
       // if the user wants to bypass timestep
       m_noTimestep = true;
@@ -320,9 +712,64 @@ bool TestFramework::init(int argc, char *argv[])
       // if the user wants to print in-place (on one line)
       m_inPlace = true;
       break;
+    case 'L':
+      // how the leds are placed in the in-place output
+      if (strcmp(optarg, "device") == 0) {
+        m_layout = TerminalRenderer::LAYOUT_DEVICE;
+      } else if (strcmp(optarg, "strip") == 0) {
+        m_layout = TerminalRenderer::LAYOUT_STRIP;
+      } else {
+        printf("Unknown layout: %s\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'F':
+      // the max framerate of the in-place output
+      m_renderFps = strtoul(optarg, nullptr, 10);
+      if (!m_renderFps) {
+        m_renderFps = DEFAULT_RENDER_FPS;
+      }
+      break;
+    case 'u':
+      // show a status line with the in-place output
+      m_hud = true;
+      break;
+    case 'z':
+      // the ticks per second of the engine
+      m_tickrate = strtoul(optarg, nullptr, 10);
+      break;
+    case 'y':
+      // run the ticks at a higher priority
+      m_priority = true;
+      break;
+    case 'V':
+      // a multiple of real time like 4x or 0.25x, the x is optional
+      m_speed = strtod(optarg, nullptr);
+      if (m_speed < MIN_SPEED || m_speed > MAX_SPEED) {
+        printf("Speed must be between %gx and %gx: %s\n", MIN_SPEED, MAX_SPEED, optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'W':
+      // skip through long waits once the output is periodic
+      m_fastForward = true;
+      break;
+    case 'j':
+      // play an input script instead of reading the commands from stdin
+      m_scriptFile = optarg;
+      break;
+    case 'J':
+      // read the commands from a file (or the Input= of a .test) instead of stdin
+      m_inputFileName = optarg;
+      break;
     case 'r':
-      // record the inputs and dump them to a file after
+      // stream the inputs to a file as they come in
+      m_record = true;
+      break;
+    case 'w':
+      // the same to a different file
       m_record = true;
+      m_recordFile = optarg;
       break;
     case 'a':
       // autuowake prevents sleep
@@ -351,6 +798,51 @@ bool TestFramework::init(int argc, char *argv[])
       // preset the arguments on the first mode
       m_argumentsStr = optarg;
       break;
+    case 'O':
+      // read input commands from a fifo as well as stdin
+      m_controlPath = optarg;
+      break;
+    case 'I':
+      // send and receive IR over a unix socket
+      m_irPath = optarg;
+      break;
+    case 'D':
+      // connect the engine serial to a device
+      m_serialPath = optarg;
+      break;
+    case 'M':
+      // serve the metrics on a unix socket
+      m_metricsPath = optarg;
+      break;
+    case 'S':
+      // print statistics about the output on exit
+      m_outputStats = true;
+      break;
+    case 'p':
+      // time the phases of the run
+      m_profiling = true;
+      if (optarg && strcmp(optarg, "json") == 0) {
+        m_profileJson = true;
+      } else if (optarg && strcmp(optarg, "text") != 0) {
+        printf("Unknown profile format: %s\n", optarg);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'e':
+      // write a trace of the run
+      m_traceFile = optarg;
+      break;
+    case 'K':
+      // record the inputs with the ticks they came in on
+      m_recordingFile = optarg;
+      break;
+    case 'Q':
+      // replay a recording of the inputs with their ticks
+      m_replayFile = optarg;
+      break;
+    case 'X':
+      // turn a recording into plain input commands and exit
+      exit(printRecordingInput(optarg) ? EXIT_SUCCESS : EXIT_FAILURE);
     case 'h':
       // print usage and exit
       print_usage(argv[0]);
@@ -363,30 +855,90 @@ bool TestFramework::init(int argc, char *argv[])
 
   switch (m_outputType) {
   case OUTPUT_TYPE_NONE:
-    print_usage(argv[0]);
-    exit(EXIT_SUCCESS);
+    if (m_outputFile.empty()) {
+      print_usage(argv[0]);
+      exit(EXIT_SUCCESS);
+    }
+    // only the file output
+    m_outputType = OUTPUT_TYPE_NULL;
+    m_inPlace = false;
+    break;
+  case OUTPUT_TYPE_NULL:
+    // there is nothing to draw in-place
+    m_inPlace = false;
     break;
   case OUTPUT_TYPE_COLOR:
     setColoredOutput(true);
+    {
+      // build the palette lookup before the leds are installed
+      ColorPalette::Mode mode;
+      if (!ColorPalette::parse(m_colorModeStr.c_str(), mode)) {
+        printf("Unknown color mode: %s\n", m_colorModeStr.c_str());
+        exit(EXIT_FAILURE);
+      }
+      m_palette.init(mode);
+    }
     break;
   case OUTPUT_TYPE_HEX:
     setHexOutput(true);
     break;
+  case OUTPUT_TYPE_BINARY:
+    // binary output can't be printed in-place
+    m_inPlace = false;
+    if (!m_outputFile.empty()) {
+      printf("Binary output can't be written to a file with --output\n");
+      exit(EXIT_FAILURE);
+    }
+    break;
+  }
+
+  if (m_headless) {
+    // the frames are written after the run so there is nothing to time or
+    // show while it's going
+    m_noTimestep = true;
+    m_inPlace = false;
+  }
+  if (m_noTimestep && m_speed != 1.0) {
+    fprintf(stderr, "The --speed is ignored without a timestep\n");
+  }
+  if (m_hud && !m_inPlace) {
+    fprintf(stderr, "The --hud is only shown with --in-place\n");
+    m_hud = false;
+  }
+
+  if (!m_traceFile.empty() && !m_trace.init(m_traceFile.c_str())) {
+    printf("Failed to open trace file: %s\n", m_traceFile.c_str());
+    exit(EXIT_FAILURE);
   }
 
   // do the vortex init/setup
+  uint64_t start = TickProfiler::now();
   Vortex::init<TestFrameworkCallbacks>();
+  if (m_profiling) {
+    m_profiler.record(TickProfiler::PHASE_INIT, TickProfiler::now() - start);
+  }
+  m_trace.span("init", start, TickProfiler::now());
 
   // configure the vortex engine as the parameters dictate
   Vortex::setInstantTimestep(m_noTimestep);
-  Vortex::enableCommandLog(m_record);
+  if (m_tickrate) {
+    Vortex::setTickrate(m_tickrate);
+  }
+  // the log of input commands grows for the whole run and nothing reads it,
+  // the inputs are captured on their way into the engine instead
+  Vortex::enableCommandLog(false);
   Vortex::enableLockstep(m_lockstep);
   Vortex::enableStorage(m_storage);
   if (m_storage) {
     Vortex::setStorageFilename(m_storageFile);
     if (access(m_storageFile.c_str(), F_OK) == 0) {
       // load storage if the file exists
+      start = TickProfiler::now();
       Vortex::loadStorage();
+      if (m_profiling) {
+        m_profiler.record(TickProfiler::PHASE_STORAGE, TickProfiler::now() - start);
+      }
+      m_trace.span("load storage", start, TickProfiler::now());
     }
   }
   Vortex::setSleepEnabled(m_sleepEnabled);
@@ -423,16 +975,64 @@ bool TestFramework::init(int argc, char *argv[])
     // TODO: add arg for the led position
     Vortex::setPatternArgs(LED_ALL, args);
   }
-  if (m_inPlace && !system("clear")) {
-    printf("Failed to clear\n");
+  set_terminal_nonblocking();
+
+  if (m_profiling) {
+    // the writers record their syscalls from their own threads
+    m_output.setProfile(m_profiler.phase(TickProfiler::PHASE_WRITE));
+    m_fileOutput.setProfile(m_profiler.phase(TickProfiler::PHASE_FILE_WRITE));
+  }
+#ifndef WASM
+  // everything printed by show() is handed off to a writer thread, the
+  // in-place output has its own thread so it writes directly and the null
+  // output doesn't write anything at all
+  bool direct = (m_inPlace || m_outputType == OUTPUT_TYPE_NULL);
+  m_output.init(STDOUT_FILENO, direct ? 0 : OUTPUT_RING_SIZE);
+#else
+  m_output.init(STDOUT_FILENO, 0);
+#endif
+  if (!setupSinks() || !setupUntil()) {
+    exit(EXIT_FAILURE);
+  }
+#ifndef WASM
+  if (m_output.isActive() || m_fileOutput.isActive()) {
+    // a kill still writes out the frames that are waiting in the rings
+    CommandLogWriter::handleFatalSignals();
+  }
+#endif
+  // a headless run with the null output has nowhere to put the frames
+  m_captureFrames = m_headless && (m_sink.isActive() || m_framesCallback ||
+    m_outputType == OUTPUT_TYPE_BINARY);
+  if (m_captureFrames && !m_frames.init(m_numLeds, m_maxTicks)) {
+    printf("Failed to allocate the frame buffer\n");
+    exit(EXIT_FAILURE);
+  }
+#ifndef WASM
+  if (!setupReactor() || !setupFastForward() || !setupFeed()) {
+    exit(EXIT_FAILURE);
   }
+#endif
 
-  set_terminal_nonblocking();
-  get_terminal_size();
+  if (m_outputType == OUTPUT_TYPE_BINARY) {
+    writeBinaryHeader();
+  }
 
   m_initialized = true;
+  m_profiler.start();
 
 #ifndef WASM
+  if (!startMetrics()) {
+    exit(EXIT_FAILURE);
+  }
+  if (m_inPlace) {
+    // draw the in-place output from a separate thread
+    startRenderThread();
+  }
+  if (m_priority) {
+    // only the tick thread is raised, the threads above were started first
+    // so they keep the normal priority
+    raisePriority();
+  }
 #else
   // NOTE: This call does not return and will instead automatically 
   // call the TestFramework::run() in a loop
@@ -447,133 +1047,1717 @@ void TestFramework::run()
   if (!stillRunning()) {
     return;
   }
-  if (!Vortex::tick()) {
+  if (m_headless) {
+    runHeadless();
+    return;
+  }
+#ifndef WASM
+  if (m_fastForward && fastForward()) {
+    // the frames of a wait were predicted instead of ticked
+    if (m_untilStop) {
+      cleanup();
+    }
+    return;
+  }
+  if (m_replay.isLoaded() && !replayInput()) {
+    // the recorded run stopped here
+    cleanup();
+    return;
+  }
+  if (m_passthrough) {
+    passInput();
+  }
+  if ((m_script.isLoaded() || m_inputFile.isOpen()) && !m_fastForward) {
+    feedInput();
+  }
+#endif
+  uint32_t frames = m_frameCount;
+  if (!tickEngine() || m_untilStop) {
     cleanup();
   }
+  // a tick that didn't show anything means the engine had nothing to do
+  m_tickShowed = (m_frameCount != frames);
+#ifndef WASM
+  if (m_untilInteractive) {
+    startInteractive();
+  }
+  if (m_hud) {
+    m_hudSleeping.store(Vortex::isSleeping(), memory_order_relaxed);
+    m_hudTicks.store(m_frameCount, memory_order_relaxed);
+  }
+#endif
 }
 
-void TestFramework::cleanup()
+bool TestFramework::tickEngine()
 {
-  DEBUG_LOG("Quitting...");
-  if (m_inPlace) {
-    printf("\n");
+  // the engine is whatever part of the tick isn't show()
+  uint32_t tick = m_frameCount;
+  m_showTime = 0;
+  uint64_t start = TickProfiler::now();
+  bool result = Vortex::tick();
+  uint64_t end = TickProfiler::now();
+#ifndef WASM
+  m_recordLog.poll(end);
+  m_recording.poll(end);
+#endif
+  m_metrics.recordTick(end - start);
+  bool pressed = Vortex::isButtonPressed();
+  if (pressed != m_metricsPressed) {
+    m_metrics.addButtonEvent();
+    m_metricsPressed = pressed;
+  }
+  if (end >= m_nextMetricsPoll) {
+    pollMetrics(end);
+  }
+#ifndef WASM
+  if (g_metricsRequested) {
+    dumpMetrics();
+  }
+#endif
+  if (m_profiling) {
+    m_profiler.record(TickProfiler::PHASE_ENGINE, (end - start) - m_showTime);
+    m_profiler.countTick();
+  }
+  if (m_trace.isActive()) {
+    traceTick(tick, start, end);
+  }
+  return result;
+}
+
+void TestFramework::pollMetrics(uint64_t now)
+{
+  m_nextMetricsPoll = now + METRICS_POLL_INTERVAL;
+#ifndef WASM
+  m_metrics.addStorageSaves(countStorageSaves());
+#endif
+}
+
+#ifndef WASM
+void TestFramework::dumpMetrics()
+{
+  g_metricsRequested = 0;
+  pollMetrics(TickProfiler::now());
+  char text[METRICS_TEXT_SIZE];
+  size_t len = m_metrics.format(text, sizeof(text), bytesWritten());
+  if (write(STDERR_FILENO, text, len) < 0) {
+    // nowhere else to report it
   }
-  if (m_record) {
-    // Open the file in write mode
-    FILE *outputFile = fopen(RECORD_FILE, "w");
-    if (outputFile) {
-      // Print the recorded input to the file
-      fprintf(outputFile, "%s", Vortex::getCommandLog().c_str());
-      // Close the output file
-      fclose(outputFile);
+}
+
+bool TestFramework::startMetrics()
+{
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onMetricsSignal;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &sa, nullptr);
+  if (m_storage) {
+    // the engine saves without telling the framework so the file is watched,
+    // the directory is watched in case the file is replaced instead of written
+    string dir = ".";
+    m_storageName = m_storageFile;
+    size_t slash = m_storageFile.rfind('/');
+    if (slash != string::npos) {
+      dir = m_storageFile.substr(0, slash ? slash : 1);
+      m_storageName = m_storageFile.substr(slash + 1);
+    }
+    m_storageWatchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_storageWatchFd >= 0 && inotify_add_watch(m_storageWatchFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+      close(m_storageWatchFd);
+      m_storageWatchFd = -1;
     }
-    printf("Wrote recorded input to " RECORD_FILE "\n");
   }
-  m_keepGoing = false;
-  m_isPaused = false;
-  Vortex::cleanup();
-#ifdef WASM
-  emscripten_force_exit(0);
+  if (m_metricsPath.empty()) {
+    return true;
+  }
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (m_metricsPath.length() >= sizeof(addr.sun_path)) {
+    printf("Metrics socket path is too long: %s\n", m_metricsPath.c_str());
+    return false;
+  }
+  strcpy(addr.sun_path, m_metricsPath.c_str());
+  m_metricsFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  unlink(m_metricsPath.c_str());
+  if (m_metricsFd < 0 || bind(m_metricsFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(m_metricsFd, 4) != 0) {
+    printf("Failed to listen for metrics on: %s\n", m_metricsPath.c_str());
+    return false;
+  }
+  // the socket is answered from its own thread so a slow client never
+  // holds up the ticks, it only reads the counters
+  m_metricsServing = true;
+  m_metricsThread = thread(&TestFramework::metricsLoop, this);
+  return true;
+}
+
+void TestFramework::stopMetrics()
+{
+  if (m_metricsThread.joinable()) {
+    m_metricsServing = false;
+    m_metricsThread.join();
+  }
+  if (m_metricsFd >= 0) {
+    close(m_metricsFd);
+    m_metricsFd = -1;
+    unlink(m_metricsPath.c_str());
+  }
+  if (m_storageWatchFd >= 0) {
+    close(m_storageWatchFd);
+    m_storageWatchFd = -1;
+  }
+}
+
+void TestFramework::metricsLoop()
+{
+  while (m_metricsServing.load(memory_order_relaxed)) {
+    struct pollfd pfd = { m_metricsFd, POLLIN, 0 };
+    if (poll(&pfd, 1, METRICS_ACCEPT_TIMEOUT_MS) <= 0) {
+      continue;
+    }
+    int client = accept4(m_metricsFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+      continue;
+    }
+    // one snapshot per connection then hang up
+    char text[METRICS_TEXT_SIZE];
+    size_t len = m_metrics.format(text, sizeof(text), bytesWritten());
+    send(client, text, len, MSG_NOSIGNAL);
+    close(client);
+  }
+}
+
+uint64_t TestFramework::countStorageSaves()
+{
+  if (m_storageWatchFd < 0) {
+    return 0;
+  }
+  uint64_t saves = 0;
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t amt;
+  while ((amt = read(m_storageWatchFd, buf, sizeof(buf))) > 0) {
+    for (ssize_t pos = 0; pos < amt;) {
+      const struct inotify_event *event = (const struct inotify_event *)(buf + pos);
+      if (event->len && m_storageName == event->name) {
+        saves++;
+      }
+      pos += sizeof(struct inotify_event) + event->len;
+    }
+  }
+  return saves;
+}
 #endif
+
+uint64_t TestFramework::bytesWritten() const
+{
+  return m_output.bytesWritten() + m_fileOutput.bytesWritten();
 }
 
-// when the glove framework calls 'FastLED.show'
-void TestFramework::show()
+void TestFramework::traceTick(uint32_t tick, uint64_t start, uint64_t end)
 {
-  if (!m_initialized) {
-    return;
+  char arg[16];
+  snprintf(arg, sizeof(arg), "%u", tick);
+  m_trace.span("tick", start, end, "tick", arg);
+  bool pressed = Vortex::isButtonPressed();
+  if (pressed != m_tracePressed) {
+    m_trace.instant(pressed ? "button press" : "button release", end);
+    m_tracePressed = pressed;
   }
-  string out;
-  get_terminal_size();
-  uint32_t wid = terminal_size.ws_col;// & 0xFFFFFFFC;
-  uint32_t odd = (wid) % 2;
-  uint32_t halfwid = wid / 2;
-  uint32_t midWid = (halfwid - ((2 + (m_outputType == OUTPUT_TYPE_HEX)) * LED_COUNT)) - 1;
-  if (m_inPlace) {
-    // this resets the cursor back to the beginning of the line and moves it up 12 lines
-    out += "\33[2K\033[17A\r";
-    // this is the top border line
-    out += "+";
-    out += LINE((wid + odd) - 2);
-    out += "+\n|";
-    // this is the left inner line
-    out += LINE(midWid + odd);
-    out += "=";
+}
+
+void TestFramework::traceCommands(const char *data, size_t len, uint64_t time)
+{
+  // each command with its count, a count that was split from its command
+  // across two writes is dropped
+  size_t pos = 0;
+  while (pos < len) {
+    size_t next = pos + 1;
+    while (next < len && isdigit(data[next])) {
+      next++;
+    }
+    char command = data[pos];
+    if (!isspace(command) && !isdigit(command)) {
+      m_traceArgs = "{\"command\":\"";
+      m_traceArgs.append(data + pos, next - pos);
+      m_traceArgs += "\"}";
+      m_trace.instant(commandName(command), time, m_traceArgs.c_str());
+    }
+    pos = next;
   }
-  if (m_outputType == OUTPUT_TYPE_COLOR) {
-    // the color strip itself
-    for (uint32_t i = 0; i < m_numLeds; ++i) {
-      out += "\x1B[0m["; // opening |
-      out += "\x1B[48;2;"; // colorcode start
-      out += to_string(m_ledList[i].red) + ";"; // col red
-      out += to_string(m_ledList[i].green) + ";"; // col green
-      out += to_string(m_ledList[i].blue) + "m"; // col blue
-      out += "  "; // colored space
-      out += "\x1B[0m]"; // ending |
+}
+
+void TestFramework::traceLeds(uint64_t time)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  // the first frame counts as a change of every led
+  bool first = !m_traceLeds;
+  if (first) {
+    m_traceLeds = new RGBColor[m_numLeds];
+  }
+  m_traceArgs.clear();
+  for (uint32_t i = 0; i < m_numLeds; ++i) {
+    const RGBColor &led = m_ledList[i];
+    if (!first && memcmp(&led, m_traceLeds + i, sizeof(RGBColor)) == 0) {
+      continue;
     }
-  } else if (m_outputType == OUTPUT_TYPE_HEX) {
-    // otherwise this just prints out the raw hex code if not in color mode
-    for (uint32_t i = 0; i < m_numLeds; ++i) {
-      char buf[128] = { 0 };
-      snprintf(buf, sizeof(buf), "%06X", m_ledList[i].raw());
-      out += buf;
+    m_traceLeds[i] = led;
+    char entry[32];
+    const uint8_t rgb[3] = { led.red, led.green, led.blue };
+    int len = snprintf(entry, sizeof(entry), "%s\"%u\":\"", m_traceArgs.empty() ? "{" : ",", i);
+    for (uint32_t c = 0; c < 3; ++c) {
+      entry[len++] = hex[rgb[c] >> 4];
+      entry[len++] = hex[rgb[c] & 0xF];
     }
-  } else { // OUTPUT_TYPE_NONE
-    // do nothing
+    entry[len++] = '"';
+    m_traceArgs.append(entry, len);
+  }
+  if (!m_traceArgs.empty()) {
+    m_traceArgs += "}";
+    m_trace.instant("leds", time, m_traceArgs.c_str());
   }
-  if (!m_inPlace) {
-    out += "\n";
-  } else {
-    // the right inner line
-    out += "=";
-    out += LINE((midWid - 1) + odd);
-    // the end of middle line, fold and start of 3rd line
-    out += "|\n+";
-    out += LINE((wid + odd) - 2);
-    // space line after the box and before usage
-    out += "+\n";
-    out += SPACES(wid + odd);
-    // the usage message
-    for (uint32_t i = 0; i < NUM_USAGE; ++i) {
-      const char *brief = (wid < 70) ? input_usage_brief[i] : input_usage[i];
-      out += brief;
-      out += SPACES((wid + odd + 1) - strlen(brief));
-    }
-  }
-  printf("%s", out.c_str());
-  fflush(stdout);
 }
 
-bool TestFramework::isButtonPressed() const
+void TestFramework::wait()
 {
-  return Vortex::isButtonPressed();
+#ifndef WASM
+  if (!stillRunning() || !m_useReactor) {
+    return;
+  }
+  if (m_replay.isLoaded() && !replayInput()) {
+    // run() stops it
+    return;
+  }
+  uint64_t start = EventReactor::now();
+  bool waitForInput = m_lockstep && !m_tickShowed;
+  if (waitForInput) {
+    m_inputArrived = false;
+  }
+  if (m_readStdin) {
+    handleInput(m_saved_stdin, EPOLLIN);
+  }
+  if (waitForInput) {
+    // lockstep is waiting for input, nothing happens till it comes so the
+    // tick timer is stopped till then
+    m_reactor.setDeadline(0, 0);
+    // this could be a long wait so the recordings are written out first
+    CommandLogWriter::flushAll();
+    while (!m_inputArrived && stillRunning()) {
+      m_reactor.poll(-1);
+      if (g_metricsRequested) {
+        dumpMetrics();
+      }
+    }
+    // the tick that was waiting runs right away and the schedule restarts
+    m_nextTick = EventReactor::now();
+  } else if (!m_tickPeriod) {
+    // no timestep, just handle whatever is ready and go
+    m_reactor.poll(0);
+    return;
+  } else if (start >= m_nextTick) {
+    // the tick is already due or behind, only pick up input on the way
+    m_reactor.poll(0);
+    scheduleTick(EventReactor::now());
+    return;
+  } else {
+    // sleep till the tick is due, handling input as it comes in
+    m_reactor.setDeadline(m_nextTick, 0);
+    while (!m_reactor.takeExpirations() && stillRunning()) {
+      m_reactor.poll(-1);
+      if (g_metricsRequested) {
+        dumpMetrics();
+      }
+    }
+    scheduleTick(EventReactor::now());
+  }
+  m_idleWaits++;
+  m_idleTime += EventReactor::now() - start;
+#endif
 }
 
-bool TestFramework::stillRunning() const
+#ifndef WASM
+void TestFramework::scheduleTick(uint64_t now)
 {
-  return (m_initialized && m_keepGoing);
+  // how far past its deadline this tick is starting
+  uint64_t late = (now > m_nextTick) ? (now - m_nextTick) : 0;
+  m_tickLateness.record(late);
+  if (late >= m_tickPeriod) {
+    m_tickOverruns++;
+  }
+  // the deadlines stay on the original schedule so a late tick is followed
+  // by ticks back to back until it's caught up
+  m_nextTick += m_tickPeriod;
+  if (now > m_nextTick + TICK_CATCHUP_LIMIT) {
+    // too far behind to catch up, drop the missed ticks and start over
+    m_ticksSkipped += (now - m_nextTick) / m_tickPeriod;
+    m_nextTick = now + m_tickPeriod;
+  }
 }
 
-void TestFramework::installLeds(CRGB *leds, uint32_t count)
+void TestFramework::setSpeed(double speed)
 {
-  m_ledList = (RGBColor *)leds;
-  m_numLeds = count;
+  if (speed < MIN_SPEED) {
+    speed = MIN_SPEED;
+  } else if (speed > MAX_SPEED) {
+    speed = MAX_SPEED;
+  }
+  m_speed = speed;
+  // the engine still sees the same number of ticks per second of its own
+  // time, only the wall clock time between them changes
+  m_tickPeriod = (uint64_t)(m_baseTickPeriod / m_speed);
+  if (!m_tickPeriod) {
+    m_tickPeriod = 1;
+  }
+  m_hudTarget.store((uint32_t)(1000000000 / m_tickPeriod), memory_order_relaxed);
+  // start the schedule over so a change doesn't cause a burst of ticks
+  m_nextTick = EventReactor::now();
 }
 
-long TestFramework::TestFrameworkCallbacks::checkPinHook(uint32_t pin)
+void TestFramework::raisePriority()
 {
-  if (pin == 20) {
-    // orbit button 2
-    return Vortex::isButtonPressed(1) ? 0 : 1;
+  // a realtime policy needs privileges so fall back to the best nice value
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = sched_get_priority_min(SCHED_FIFO) + TICK_PRIORITY;
+  if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0) {
+    return;
+  }
+  if (setpriority(PRIO_PROCESS, 0, TICK_NICE) != 0) {
+    fprintf(stderr, "Could not raise the tick priority: %s\n", strerror(errno));
   }
-  return Vortex::isButtonPressed(0) ? 0 : 1;
 }
 
-void TestFramework::TestFrameworkCallbacks::ledsInit(void *cl, int count)
+void TestFramework::printTickStats()
+{
+  if (!m_tickLateness.count()) {
+    return;
+  }
+  fprintf(stderr, "Ticks: %" PRIu64 " at %uHz x%g, %" PRIu64 " overruns, %" PRIu64 " skipped, lateness p50",
+    m_tickLateness.count(), Vortex::getTickrate(), m_speed, m_tickOverruns, m_ticksSkipped);
+  printDuration(stderr, m_tickLateness.percentile(50));
+  fprintf(stderr, " p99");
+  printDuration(stderr, m_tickLateness.percentile(99));
+  fprintf(stderr, " max");
+  printDuration(stderr, m_tickLateness.max());
+  fprintf(stderr, "\n");
+  m_tickLateness.print(stderr, "  ");
+}
+#endif
+
+#ifndef WASM
+bool TestFramework::setupReactor()
+{
+  // the reactor is only needed if there is ever something to wait for, a
+  // plain --no-timestep run lets the engine read stdin itself
+  bool connections = !m_controlPath.empty() || !m_irPath.empty() || !m_serialPath.empty();
+  // the interactive --until-action needs it to take over from the feeds
+  bool interactive = !m_untilExpr.empty() && m_untilAction == UNTIL_INTERACTIVE;
+  m_useReactor = !m_headless && (!m_noTimestep || m_lockstep || connections || interactive);
+  if (!m_useReactor) {
+    return true;
+  }
+  if (!m_reactor.init()) {
+    printf("Failed to create the event reactor\n");
+    return false;
+  }
+  // the engine reads its commands from a pipe on stdin and everything that
+  // has input for it (stdin, the control fifo) is forwarded into the pipe
+  if (!redirectInput()) {
+    printf("Failed to create the input pipe\n");
+    return false;
+  }
+  fcntl(m_pipe_fd[1], F_SETFL, fcntl(m_pipe_fd[1], F_GETFL, 0) | O_NONBLOCK);
+  if (!m_reactor.add(m_saved_stdin, EPOLLIN, inputCallback, this)) {
+    // epoll can't wait on a file (like < input.txt) but it's always ready
+    // so it's read on each wait instead
+    m_readStdin = true;
+  }
+  if (!m_controlPath.empty()) {
+    // open it read/write so it never hangs up when a writer goes away
+    if (mkfifo(m_controlPath.c_str(), 0600) != 0 && errno != EEXIST) {
+      printf("Failed to create control fifo: %s\n", m_controlPath.c_str());
+      return false;
+    }
+    m_controlFd = open(m_controlPath.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (m_controlFd < 0) {
+      printf("Failed to open control fifo: %s\n", m_controlPath.c_str());
+      return false;
+    }
+    m_reactor.add(m_controlFd, EPOLLIN, inputCallback, this);
+  }
+  if (!m_irPath.empty() && !setupIR()) {
+    printf("Failed to connect IR: %s\n", m_irPath.c_str());
+    return false;
+  }
+  if (!m_serialPath.empty()) {
+    m_serialFd = open(m_serialPath.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (m_serialFd < 0) {
+      printf("Failed to open serial device: %s\n", m_serialPath.c_str());
+      return false;
+    }
+    struct termios attr;
+    if (tcgetattr(m_serialFd, &attr) == 0) {
+      // a real serial port or pty, pass the bytes through untouched
+      cfmakeraw(&attr);
+      tcsetattr(m_serialFd, TCSANOW, &attr);
+    }
+    m_reactor.add(m_serialFd, EPOLLIN, serialCallback, this);
+  }
+  if (!m_noTimestep) {
+    startTimestep();
+  }
+  return true;
+}
+
+void TestFramework::startTimestep()
+{
+  // the ticks are paced by the reactor timer instead of the engine busy
+  // waiting for its timestep
+  uint32_t tickrate = Vortex::getTickrate();
+  m_baseTickPeriod = 1000000000 / (tickrate ? tickrate : 1);
+  Vortex::setInstantTimestep(true);
+  setSpeed(m_speed);
+}
+
+void TestFramework::startInteractive()
+{
+  m_untilInteractive = false;
+  // the rest of the feed is dropped so stdin drives from here, whatever the
+  // engine was already given still plays out
+  m_script.unload();
+  m_inputFile.close();
+  m_replay.unload();
+  m_inputBuffer.clear();
+  forwardInput();
+  if (m_noTimestep) {
+    // the search ran as fast as it could, a person needs real time
+    m_noTimestep = false;
+    startTimestep();
+  }
+}
+
+bool TestFramework::redirectInput()
+{
+  if (pipe2(m_pipe_fd, O_CLOEXEC) != 0) {
+    return false;
+  }
+  m_saved_stdin = dup(STDIN_FILENO);
+  dup2(m_pipe_fd[0], STDIN_FILENO);
+  return true;
+}
+
+void TestFramework::restoreInput()
+{
+  // give the engine back the real stdin
+  if (m_saved_stdin >= 0) {
+    dup2(m_saved_stdin, STDIN_FILENO);
+    close(m_saved_stdin);
+    m_saved_stdin = -1;
+    m_readStdin = false;
+  }
+  for (uint32_t i = 0; i < 2; ++i) {
+    if (m_pipe_fd[i] >= 0) {
+      close(m_pipe_fd[i]);
+      m_pipe_fd[i] = -1;
+    }
+  }
+}
+
+bool TestFramework::setupFastForward()
+{
+  if (!m_fastForward) {
+    return true;
+  }
+  if (!m_replayFile.empty()) {
+    // the recorded input has to come in on the ticks it was recorded on
+    fprintf(stderr, "The --fast-forward can't be used with --replay\n");
+    m_fastForward = false;
+    return true;
+  }
+  if (!m_noTimestep || m_lockstep || m_useReactor) {
+    // a wait has to be ticks the engine runs on its own as fast as it can
+    fprintf(stderr, "The --fast-forward needs --no-timestep or a headless run, without --lockstep or connections\n");
+    m_fastForward = false;
+    return true;
+  }
+  if (m_sleepEnabled) {
+    // the engine can fall asleep on its own timer in the middle of a wait
+    // and that timer doesn't run while the frames are predicted
+    fprintf(stderr, "The --fast-forward needs --autowake so the sleep timer can't go off during a wait\n");
+    m_fastForward = false;
+    return true;
+  }
+  // the input is handed to the engine one stretch at a time through a pipe
+  // so the long waits can be held back and run here instead
+  if (!redirectInput()) {
+    printf("Failed to create the input pipe\n");
+    return false;
+  }
+  if (!m_periods.init(m_numLeds)) {
+    printf("Failed to allocate the fast-forward history\n");
+    return false;
+  }
+  return true;
+}
+
+bool TestFramework::fastForward()
+{
+  readFastForwardInput();
+  if (!m_ffBacklog && !m_ffWait) {
+    queueFastForwardInput();
+  }
+  if (m_ffBacklog) {
+    // the engine is still working through the commands it was given
+    m_ffBacklog--;
+    return false;
+  }
+  if (!m_ffWait) {
+    // out of input, the engine keeps ticking like it normally would
+    return false;
+  }
+  // the engine waits on its own while it has nothing queued, so the ticks
+  // of the wait are run with an empty queue till there is a period
+  if (m_ffCheckIn) {
+    m_ffCheckIn--;
+    m_ffWait--;
+    return false;
+  }
+  m_ffCheckIn = PERIOD_CHECK_INTERVAL;
+  uint32_t skip = predictWait();
+  if (!skip) {
+    m_ffWait--;
+    return false;
+  }
+  m_ffWait -= skip;
+  return true;
+}
+
+uint32_t TestFramework::predictWait()
+{
+  // anything in the engine that runs on a timer could go off in the middle
+  // of the wait so those are always ticked for real
+  if (Vortex::isButtonPressed() || Vortex::isSleeping() || Menus::checkInMenu()) {
+    return 0;
+  }
+  // the auto-cycle switches modes on a timer so it would be skipped past
+  if (VortexEngine::autoCycleEnabled()) {
+    return 0;
+  }
+  uint32_t period = m_periods.period();
+  if (!period) {
+    return 0;
+  }
+  // only whole cycles are predicted so the engine is at the same point of the
+  // cycle for the rest of the wait as it would have been
+  uint32_t skip = m_ffWait;
+  if (m_maxTicks && m_maxTicks - m_frameCount < skip) {
+    skip = m_maxTicks - m_frameCount;
+  }
+  skip -= skip % period;
+  for (uint32_t i = 1; i <= skip; ++i) {
+    emitFrame(m_periods.predict(i, period));
+    if (m_untilStop) {
+      // the run ends on this frame
+      skip = i;
+      break;
+    }
+  }
+  if (skip) {
+    m_ffTicks += skip;
+    m_ffSkips++;
+  }
+  return skip;
+}
+
+void TestFramework::readFastForwardInput()
+{
+  if (m_ffInputDone) {
+    return;
+  }
+  if (m_script.isLoaded() || m_inputFile.isOpen()) {
+    // only as much of the feed as the next stretch needs
+    if (m_ffInput.size() < INPUT_CHUNK_SIZE) {
+      char buf[INPUT_CHUNK_SIZE];
+      size_t len = 0;
+      uint64_t ticks = 0;
+      const char *data = nextFeed(buf, sizeof(buf), 0, len, ticks);
+      m_ffInput.append(data, len);
+      m_recordLog.write(data, len);
+      m_ffInputDone = feedDone();
+    }
+    return;
+  }
+  char buf[INPUT_CHUNK_SIZE];
+  ssize_t amt = read(m_saved_stdin, buf, sizeof(buf));
+  if (amt > 0) {
+    m_ffInput.append(buf, amt);
+    // the waits that are predicted never reach the engine so the input is
+    // recorded as it was read instead
+    m_recordLog.write(buf, amt);
+  } else if (amt == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+    m_ffInputDone = true;
+  }
+}
+
+void TestFramework::queueFastForwardInput()
+{
+  // hand over every command up to the next long wait and count how many
+  // ticks the engine will take to get through them
+  string out;
+  size_t pos = 0;
+  while (pos < m_ffInput.size() && out.size() < INPUT_CHUNK_SIZE) {
+    char command = m_ffInput[pos];
+    size_t end = pos + 1;
+    while (end < m_ffInput.size() && isdigit(m_ffInput[end])) {
+      end++;
+    }
+    if (end == m_ffInput.size() && !m_ffInputDone) {
+      // the rest of the count might still be on its way
+      break;
+    }
+    uint32_t count = strtoul(m_ffInput.c_str() + pos + 1, nullptr, 10);
+    if (!count) {
+      count = 1;
+    }
+    if (command == 'w' && count >= MIN_FAST_FORWARD_WAIT) {
+      if (out.empty()) {
+        m_ffWait = count;
+        m_ffCheckIn = 0;
+        pos = end;
+      }
+      break;
+    }
+    if (command && strchr(TICK_COMMANDS, command)) {
+      m_ffBacklog += count;
+    }
+    out.append(m_ffInput, pos, end - pos);
+    pos = end;
+  }
+  m_ffInput.erase(0, pos);
+  writeInput(out.data(), out.size());
+}
+
+bool TestFramework::setupFeed()
+{
+  string error;
+  if (m_record && !m_recordLog.open(m_recordFile.c_str())) {
+    printf("Failed to create recording: %s\n", m_recordFile.c_str());
+    return false;
+  }
+  if (!m_recordingFile.empty() && !m_recording.create(m_recordingFile.c_str())) {
+    printf("Failed to create recording: %s\n", m_recordingFile.c_str());
+    return false;
+  }
+  bool recording = m_recordLog.isOpen() || m_recording.isRecording();
+  if (recording) {
+    // a crash or kill still leaves the recording behind
+    CommandLogWriter::handleFatalSignals();
+  }
+  uint32_t feeds = !m_scriptFile.empty() + !m_inputFileName.empty() + !m_replayFile.empty();
+  if (!feeds) {
+    if ((recording || !m_metricsPath.empty() || m_trace.isActive()) && m_pipe_fd[1] < 0) {
+      // the engine would read stdin itself, instead the input is passed
+      // through so it can be recorded, counted and traced on the way
+      if (!redirectInput()) {
+        printf("Failed to create the input pipe\n");
+        return false;
+      }
+      m_passthrough = true;
+    }
+    return true;
+  }
+  if (feeds > 1) {
+    printf("Only one of --script, --input-file and --replay can be used\n");
+    return false;
+  }
+  if (!m_replayFile.empty() && !m_replay.load(m_replayFile.c_str(), error)) {
+    printf("Failed to load recording %s: %s\n", m_replayFile.c_str(), error.c_str());
+    return false;
+  }
+  if (!m_scriptFile.empty() && !m_script.loadFile(m_scriptFile.c_str(), error)) {
+    printf("Failed to load script %s: %s\n", m_scriptFile.c_str(), error.c_str());
+    return false;
+  }
+  if (!m_inputFileName.empty() && !m_inputFile.open(m_inputFileName.c_str(), error)) {
+    printf("Failed to open input file %s: %s\n", m_inputFileName.c_str(), error.c_str());
+    return false;
+  }
+  // the reactor and the fast-forward already put the engine on a pipe,
+  // otherwise the feed takes the place of stdin
+  if (m_pipe_fd[1] < 0 && !redirectInput()) {
+    printf("Failed to create the input pipe\n");
+    return false;
+  }
+  return true;
+}
+
+bool TestFramework::feedDone() const
+{
+  return m_script.isLoaded() ? m_script.done() : m_inputFile.done();
+}
+
+const char *TestFramework::nextFeed(char *buf, size_t size, uint32_t maxRepeat, size_t &len, uint64_t &ticks)
+{
+  if (m_script.isLoaded()) {
+    len = m_script.generate(buf, size, maxRepeat, ticks);
+    return buf;
+  }
+  // the input file is written straight out of the mapping
+  const char *data = m_inputFile.next(size, len);
+  ticks += countTicks(data, len);
+  return data;
+}
+
+uint64_t TestFramework::countTicks(const char *data, size_t len)
+{
+  uint64_t ticks = 0;
+  for (size_t pos = 0; pos < len;) {
+    char command = data[pos++];
+    if (!strchr(TICK_COMMANDS, command) || !command) {
+      continue;
+    }
+    uint64_t count = 0;
+    while (pos < len && isdigit(data[pos])) {
+      count = (count * 10) + (data[pos++] - '0');
+    }
+    ticks += count ? count : 1;
+  }
+  return ticks;
+}
+
+void TestFramework::feedInput()
+{
+  if (m_feedBacklog) {
+    m_feedBacklog--;
+  }
+  bool handover = m_untilWatching && m_untilAction == UNTIL_INTERACTIVE;
+  if (m_feedBacklog >= (handover ? 1 : FEED_BACKLOG) || feedDone()) {
+    return;
+  }
+  char buf[INPUT_CHUNK_SIZE];
+  size_t len = 0;
+  uint32_t maxRepeat = (m_inPlace || handover) ? IN_PLACE_MAX_REPEAT : 0;
+  const char *data = nextFeed(buf, handover ? HANDOVER_CHUNK_SIZE : sizeof(buf), maxRepeat, len, m_feedBacklog);
+  writeFeed(data, len);
+}
+
+bool TestFramework::replayInput()
+{
+  if (m_replay.ended(m_frameCount)) {
+    return false;
+  }
+  // whatever is due goes in right before the tick so the engine reads it on
+  // the same tick it did when it was recorded
+  string commands;
+  if (m_replay.next(m_frameCount, commands)) {
+    writeFeed(commands.data(), commands.size());
+  }
+  return true;
+}
+
+bool TestFramework::printRecordingInput(const char *filename)
+{
+  InputRecording recording;
+  string error;
+  if (!recording.load(filename, error)) {
+    fprintf(stderr, "Failed to load recording %s: %s\n", filename, error.c_str());
+    return false;
+  }
+  // each command takes a tick per count, the gaps where the engine had
+  // nothing left to do are waits for exactly that many ticks
+  string input;
+  uint64_t tick = 0;
+  bool quit = false;
+  const vector<InputRecording::Event> &events = recording.events();
+  for (size_t i = 0; i < events.size() && !quit; ++i) {
+    const InputRecording::Event &event = events[i];
+    // digits that came in late still belong to the command before them
+    if (event.tick > tick && !isdigit(event.commands[0])) {
+      input += 'w';
+      if (event.tick - tick > 1) {
+        input += to_string(event.tick - tick);
+      }
+      tick = event.tick;
+    }
+    input += event.commands;
+    tick += countTicks(event.commands.data(), event.commands.size());
+    quit = event.commands.find('q') != string::npos;
+  }
+  if (!quit) {
+    if (recording.hasEnd() && recording.endTick() > tick) {
+      input += "w" + to_string(recording.endTick() - tick);
+    }
+    input += 'q';
+  }
+  printf("%s\n", input.c_str());
+  return true;
+}
+
+void TestFramework::writeFeed(const char *data, size_t len)
+{
+  if (m_useReactor) {
+    // in line with anything typed and forwarded when the pipe has room
+    m_inputBuffer.append(data, len);
+    forwardInput();
+    return;
+  }
+  // the backlog keeps this well under what the pipe holds
+  writeInput(data, len);
+}
+
+void TestFramework::writeInput(const char *data, size_t len)
+{
+  size_t written = 0;
+  while (written < len) {
+    ssize_t amt = write(m_pipe_fd[1], data + written, len - written);
+    if (amt <= 0 && errno != EINTR) {
+      break;
+    }
+    written += (amt > 0) ? amt : 0;
+  }
+  captureInput(data, written);
+}
+
+void TestFramework::passInput()
+{
+  // only what's already there so this never blocks the tick
+  int avail = 0;
+  if (ioctl(m_saved_stdin, FIONREAD, &avail) != 0 || avail <= 0) {
+    return;
+  }
+  char buf[INPUT_CHUNK_SIZE];
+  ssize_t amt = read(m_saved_stdin, buf, ((size_t)avail < sizeof(buf)) ? avail : sizeof(buf));
+  if (amt > 0) {
+    writeInput(buf, amt);
+  }
+}
+
+void TestFramework::captureInput(const char *data, size_t len)
+{
+  // the engine reads whatever is in the pipe on its next tick
+  if (!m_fastForward) {
+    m_recordLog.write(data, len);
+  }
+  m_recording.record(m_frameCount, data, len);
+  if (m_trace.isActive()) {
+    traceCommands(data, len, TickProfiler::now());
+  }
+  // the counts and spaces only go with a command
+  uint64_t commands = 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (!isdigit(data[i]) && !isspace(data[i])) {
+      commands++;
+    }
+  }
+  m_metrics.addCommands(commands);
+}
+
+bool TestFramework::setupIR()
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (m_irPath.length() >= sizeof(addr.sun_path)) {
+    return false;
+  }
+  strcpy(addr.sun_path, m_irPath.c_str());
+  // connect to the other side if it's already there
+  m_irFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (m_irFd < 0) {
+    return false;
+  }
+  if (connect(m_irFd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+    return m_reactor.add(m_irFd, EPOLLIN, irCallback, this);
+  }
+  close(m_irFd);
+  m_irFd = -1;
+  // otherwise become the server and wait for it
+  m_irListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (m_irListenFd < 0) {
+    return false;
+  }
+  unlink(m_irPath.c_str());
+  if (bind(m_irListenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(m_irListenFd, 1) != 0) {
+    return false;
+  }
+  return m_reactor.add(m_irListenFd, EPOLLIN, irCallback, this);
+}
+
+void TestFramework::cleanupReactor()
+{
+  if (!m_useReactor) {
+    return;
+  }
+  restoreInput();
+  if (m_irListenFd >= 0) {
+    // the server made the socket so it removes it
+    unlink(m_irPath.c_str());
+  }
+  int *fds[] = { &m_controlFd, &m_irFd, &m_irListenFd, &m_serialFd };
+  for (uint32_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i) {
+    if (*fds[i] >= 0) {
+      close(*fds[i]);
+      *fds[i] = -1;
+    }
+  }
+  m_reactor.cleanup();
+  m_useReactor = false;
+}
+
+void TestFramework::handleInput(int fd, uint32_t events)
+{
+  char buf[INPUT_CHUNK_SIZE];
+  ssize_t amt = read(fd, buf, sizeof(buf));
+  if (amt > 0) {
+    // the speed keys are handled here and never reach the engine
+    for (ssize_t i = 0; i < amt; ++i) {
+      if (buf[i] == SPEED_UP_KEY || buf[i] == SPEED_DOWN_KEY) {
+        if (m_tickPeriod) {
+          setSpeed((buf[i] == SPEED_UP_KEY) ? (m_speed * 2) : (m_speed / 2));
+        }
+        continue;
+      }
+      m_inputBuffer += buf[i];
+    }
+    forwardInput();
+    return;
+  }
+  if (amt == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+    // closed, whatever was already sent to the engine is still handled
+    m_reactor.remove(fd);
+    if (fd == m_saved_stdin) {
+      m_readStdin = false;
+    }
+  }
+}
+
+void TestFramework::forwardInput()
+{
+  if (m_inputBuffer.size()) {
+    ssize_t amt = write(m_pipe_fd[1], m_inputBuffer.data(), m_inputBuffer.size());
+    if (amt > 0) {
+      captureInput(m_inputBuffer.data(), amt);
+      m_inputBuffer.erase(0, amt);
+      m_inputArrived = true;
+    }
+  }
+  m_hudPending.store((uint32_t)m_inputBuffer.size(), memory_order_relaxed);
+  // if the engine isn't keeping up then wait for room in the pipe
+  if (m_inputBuffer.size()) {
+    if (!m_reactor.modify(m_pipe_fd[1], EPOLLOUT)) {
+      m_reactor.add(m_pipe_fd[1], EPOLLOUT, pipeCallback, this);
+    }
+  } else {
+    m_reactor.remove(m_pipe_fd[1]);
+  }
+}
+
+void TestFramework::handleIR(int fd, uint32_t events)
+{
+  if (fd == m_irListenFd) {
+    // only one other side at a time
+    int client = accept4(m_irListenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client < 0) {
+      return;
+    }
+    if (m_irFd >= 0) {
+      close(client);
+      return;
+    }
+    m_irFd = client;
+    m_reactor.add(m_irFd, EPOLLIN, irCallback, this);
+    return;
+  }
+  char buf[INPUT_CHUNK_SIZE];
+  ssize_t amt = read(fd, buf, sizeof(buf));
+  if (amt <= 0) {
+    if (amt == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      m_reactor.remove(fd);
+      close(fd);
+      m_irFd = -1;
+      m_irBuffer.clear();
+    }
+    return;
+  }
+  // each message is a 32bit timing with the mark flag in the top bit, the
+  // same as the IRSimulator of the windows framework
+  m_irBuffer.append(buf, amt);
+  size_t pos = 0;
+  while (m_irBuffer.size() - pos >= sizeof(uint32_t)) {
+    uint32_t message = 0;
+    memcpy(&message, m_irBuffer.data() + pos, sizeof(message));
+    pos += sizeof(message);
+    Vortex::IRDeliver(message & ~(1u << 31));
+  }
+  m_irBuffer.erase(0, pos);
+}
+
+void TestFramework::handleSerial(int fd, uint32_t events)
+{
+  char buf[INPUT_CHUNK_SIZE];
+  ssize_t amt = read(fd, buf, sizeof(buf));
+  if (amt > 0) {
+    // held until the engine asks for it
+    m_serialBuffer.append(buf, amt);
+    return;
+  }
+  if (amt == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+    m_reactor.remove(fd);
+  }
+}
+
+void TestFramework::sendIR(bool mark, uint32_t amount)
+{
+  if (m_irFd < 0) {
+    return;
+  }
+  // if the other side went away it gets cleaned up when the reactor sees it
+  uint32_t message = amount | (mark ? (1u << 31) : 0);
+  send(m_irFd, &message, sizeof(message), MSG_NOSIGNAL);
+}
+#endif
+
+void TestFramework::runHeadless()
+{
+  // only the engine runs in this loop, show() just copies each frame into the
+  // frame buffer and everything is formatted and written after
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  while ((!m_maxTicks || m_frameCount < m_maxTicks) && !m_untilStop) {
+#ifndef WASM
+    if (m_fastForward && fastForward()) {
+      continue;
+    }
+    if (m_replay.isLoaded() && !replayInput()) {
+      break;
+    }
+    if (m_passthrough) {
+      passInput();
+    }
+    if ((m_script.isLoaded() || m_inputFile.isOpen()) && !m_fastForward) {
+      feedInput();
+    }
+#endif
+    if (!tickEngine()) {
+      break;
+    }
+  }
+  m_headlessTime = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+  m_profiler.stop();
+  uint64_t outputStart = TickProfiler::now();
+  writeFrames();
+  if (m_profiling) {
+    m_profiler.record(TickProfiler::PHASE_HEADLESS_OUTPUT, TickProfiler::now() - outputStart);
+  }
+  cleanup();
+}
+
+void TestFramework::writeFrames()
+{
+  if (m_framesCallback) {
+    // embedded, the frames are handed over as they are
+    m_framesCallback(m_framesArg, m_frames);
+    return;
+  }
+  RGBColor *leds = new RGBColor[m_numLeds];
+  for (uint32_t i = 0; i < m_frames.numFrames(); ++i) {
+    m_frames.frame(i, leds);
+    outputFrame(leds, m_frames.ticks()[i]);
+  }
+  delete[] leds;
+}
+
+void TestFramework::cleanup()
+{
+  DEBUG_LOG("Quitting...");
+  if (!m_headless) {
+    // the headless run already stopped the clock before writing the frames
+    m_profiler.stop();
+  }
+#ifndef WASM
+  // the render thread writes to the output and counts into the stats and the
+  // profile so it's done before any of them are flushed, closed or printed
+  stopRenderThread();
+  // the metrics thread reads the writers so it stops before they do
+  stopMetrics();
+#endif
+  // print the last frame if it's still being counted
+  flushRepeat();
+  if (m_outputType == OUTPUT_TYPE_BINARY && m_binaryFormat == BINARY_FORMAT_EVENTS) {
+    // mark the end of the events with the total tick count
+    BinaryLedEvent end = { htole32(m_frameCount), BINARY_EVENT_END, 0, 0, 0 };
+    writeOutput(&end, sizeof(end));
+  }
+  // everything below goes through stdio so write out the ring first
+  m_sink.cleanup();
+  m_output.cleanup();
+  m_fileOutput.cleanup();
+  if (m_fileOutput.fd() >= 0) {
+    close(m_fileOutput.fd());
+  }
+  // the last tick has happened so the timeline can be closed
+  m_trace.cleanup();
+  if (m_outputStats) {
+    printOutputStats();
+  }
+  if (m_profiling) {
+    // the render and writer threads are joined so their syscall times are
+    // all in and nothing records into the histograms while they're printed
+    if (m_profileJson) {
+      m_profiler.printJson(stderr);
+    } else {
+      m_profiler.print(stderr);
+    }
+  }
+  if (m_inPlace) {
+    printf("\n");
+  }
+  if (m_until.isCompiled()) {
+    if (!m_untilCount) {
+      // scripts can tell the state was never reached from the exit code
+      fprintf(stderr, "Until %s was not met in %u ticks\n", m_untilExpr.c_str(), m_frameCount);
+      m_exitCode = EXIT_FAILURE;
+    } else if (m_untilAction == UNTIL_DUMP) {
+      fprintf(stderr, "Until %s was met %u time%s in %u ticks\n", m_untilExpr.c_str(), m_untilCount,
+        (m_untilCount == 1) ? "" : "s", m_frameCount);
+    }
+  }
+  if (m_recording.isRecording()) {
+    m_recording.finish(m_frameCount);
+    fprintf(stderr, "Wrote recorded input with ticks to %s\n", m_recordingFile.c_str());
+  }
+  if (m_recordLog.isOpen()) {
+    // everything else was already streamed out as it came in
+    m_recordLog.close();
+    fprintf(stderr, "Wrote recorded input to %s\n", m_recordFile.c_str());
+  }
+  m_keepGoing = false;
+  m_isPaused = false;
+#ifndef WASM
+  cleanupReactor();
+  // the fast-forward feed redirects stdin too
+  restoreInput();
+#endif
+  Vortex::cleanup();
+#ifdef WASM
+  emscripten_force_exit(0);
+#endif
+}
+
+// when the glove framework calls 'FastLED.show'
+void TestFramework::show()
+{
+  if (!m_initialized) {
+    return;
+  }
+  bool timed = m_profiling || m_trace.isActive();
+  uint64_t start = timed ? TickProfiler::now() : 0;
+  if (m_fastForward) {
+    // only the frames the engine really showed are looked at for a period
+    m_periods.record(m_ledList);
+  }
+  emitFrame(m_ledList);
+  if (timed) {
+    uint64_t end = TickProfiler::now();
+    m_showTime += end - start;
+    if (m_profiling) {
+      m_profiler.record(TickProfiler::PHASE_SHOW, end - start);
+    }
+    if (m_trace.isActive()) {
+      m_trace.span("show", start, end);
+      traceLeds(start);
+    }
+  }
+}
+
+void TestFramework::emitFrame(const RGBColor *leds)
+{
+  // the index of this frame, there is one frame per tick
+  uint32_t frame = m_frameCount++;
+  if (m_untilWatching) {
+    checkUntil(leds, frame);
+  }
+  if (m_filterFrames && !keepFrame(frame)) {
+    // dropped before anything is formatted
+    return;
+  }
+  if (m_headless) {
+    if (m_captureFrames && !m_frames.capture(leds, frame)) {
+      // nothing was written yet, the frames are only written at the end
+      printf("Failed to grow the frame buffer\n");
+      exit(EXIT_FAILURE);
+    }
+    return;
+  }
+  outputFrame(leds, frame);
+}
+
+bool TestFramework::setupUntil()
+{
+  if (m_untilExpr.empty()) {
+    return true;
+  }
+  string error;
+  if (!m_until.compile(m_untilExpr.c_str(), m_numLeds, error)) {
+    printf("Failed to compile --until %s: %s\n", m_untilExpr.c_str(), error.c_str());
+    return false;
+  }
+  if (m_untilAction == UNTIL_INTERACTIVE && m_headless) {
+    printf("The --until-action interactive can't be used with a headless run\n");
+    return false;
+  }
+  m_untilWatching = true;
+  return true;
+}
+
+void TestFramework::checkUntil(const RGBColor *leds, uint32_t frame)
+{
+  bool met = m_until.check(leds, frame);
+  if (met && !m_untilMet) {
+    // only the tick it becomes true on, not every tick that it stays true
+    m_untilCount++;
+    switch (m_untilAction) {
+    case UNTIL_STOP:
+      fprintf(stderr, "Until %s met on tick %u\n", m_untilExpr.c_str(), frame);
+      m_untilStop = true;
+      break;
+    case UNTIL_DUMP:
+      dumpUntil(leds, frame);
+      break;
+    case UNTIL_INTERACTIVE:
+      fprintf(stderr, "Until %s met on tick %u, reading stdin from here\n", m_untilExpr.c_str(), frame);
+      m_untilInteractive = true;
+      break;
+    }
+  }
+  m_untilMet = met;
+  if (m_untilMax && !m_untilCount && frame + 1 >= m_untilMax) {
+    // the guard, a condition that never happens doesn't run forever
+    m_untilStop = true;
+  }
+  if (m_untilStop || m_untilInteractive) {
+    m_untilWatching = false;
+  }
+}
+
+void TestFramework::dumpUntil(const RGBColor *leds, uint32_t frame)
+{
+  fprintf(stderr, "Until %s met on tick %u\n", m_untilExpr.c_str(), frame);
+  fprintf(stderr, "  leds:");
+  for (uint32_t i = 0; i < m_numLeds; ++i) {
+    fprintf(stderr, " %06X", leds[i].raw());
+  }
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  menu: %s%s, sleeping: %s, button: %s\n",
+    UntilCondition::menuName(Menus::curMenuID()),
+    (Menus::curMenuID() == MENU_NONE && Menus::checkInMenu()) ? " (in the menus)" : "",
+    Vortex::isSleeping() ? "yes" : "no",
+    Vortex::isButtonPressed() ? "pressed" : "released");
+}
+
+void TestFramework::outputFrame(const RGBColor *leds, uint32_t frame)
+{
+  m_framesKept++;
+  m_metrics.addFrames(1);
+  if (m_outputType == OUTPUT_TYPE_BINARY) {
+    showBinary(leds, frame);
+    return;
+  }
+  if (m_inPlace) {
+#ifndef WASM
+    // the render thread draws the latest frame at its own pace so that a
+    // slow terminal never holds up the engine tick
+    m_snapshot.publish(leds, frame);
+    m_publishedFrame.store(frame, memory_order_relaxed);
+#else
+    renderFrame(leds);
+#endif
+  }
+  if (!m_sink.isActive()) {
+    // the null output, or in-place without a file
+    return;
+  }
+  if (m_repeatFrames) {
+    // identical frames are only counted, they get written once they end
+    if (m_repeatCount && memcmp(m_lastFrame, leds, m_numLeds * sizeof(RGBColor)) == 0) {
+      m_repeatCount++;
+      return;
+    }
+    flushRepeat();
+    memcpy(m_lastFrame, leds, m_numLeds * sizeof(RGBColor));
+    m_repeatCount = 1;
+    return;
+  }
+  m_sink.write(leds, m_numLeds, 1);
+}
+
+bool TestFramework::keepFrame(uint32_t frame)
+{
+  if (frame < m_fromTick || frame > m_toTick) {
+    return false;
+  }
+  if (m_atTicks.size()) {
+    // skip past the ticks that are behind this frame
+    while (m_nextAtTick < m_atTicks.size() && m_atTicks[m_nextAtTick] < frame) {
+      m_nextAtTick++;
+    }
+    if (m_nextAtTick >= m_atTicks.size() || m_atTicks[m_nextAtTick] != frame) {
+      return false;
+    }
+  }
+  // the nth frames are counted from the start of the window
+  return ((frame - m_fromTick) % m_every) == 0;
+}
+
+// draw a frame of leds in-place
+void TestFramework::renderFrame(const RGBColor *leds)
+{
+  // only the leds that changed are redrawn
+  m_terminal.draw(leds);
+  writeOutput(m_terminal.data(), m_terminal.size());
+}
+
+bool TestFramework::setupSinks()
+{
+  FormatSink<HexFormat> *file = nullptr;
+  if (!m_outputFile.empty()) {
+    int fd = open(m_outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      printf("Failed to open output file: %s\n", m_outputFile.c_str());
+      return false;
+    }
+#ifndef WASM
+    m_fileOutput.init(fd, OUTPUT_RING_SIZE);
+#else
+    m_fileOutput.init(fd, 0);
+#endif
+    // golden files are always in hex
+    file = new FormatSink<HexFormat>(&m_fileOutput, m_numLeds, &m_palette);
+  }
+  if (m_inPlace || m_outputType == OUTPUT_TYPE_NULL) {
+    // nothing goes to stdout through a sink, but maybe to the file
+    if (file) {
+      m_sink.bind(file);
+    }
+    return true;
+  }
+  if (m_outputType == OUTPUT_TYPE_COLOR) {
+    FormatSink<ColorFormat> *out = new FormatSink<ColorFormat>(&m_output, m_numLeds, &m_palette);
+    if (file) {
+      m_sink.bind(new TeeSink<FormatSink<ColorFormat>, FormatSink<HexFormat>>(out, file));
+    } else {
+      m_sink.bind(out);
+    }
+  } else if (m_outputType == OUTPUT_TYPE_HEX) {
+    FormatSink<HexFormat> *out = new FormatSink<HexFormat>(&m_output, m_numLeds, &m_palette);
+    if (file) {
+      m_sink.bind(new TeeSink<FormatSink<HexFormat>, FormatSink<HexFormat>>(out, file));
+    } else {
+      m_sink.bind(out);
+    }
+  }
+  return true;
+}
+
+#ifndef WASM
+void TestFramework::startRenderThread()
+{
+  m_rendering = true;
+  m_renderThread = thread(&TestFramework::renderLoop, this);
+}
+
+void TestFramework::stopRenderThread()
+{
+  if (!m_renderThread.joinable()) {
+    return;
+  }
+  m_rendering = false;
+  m_renderThread.join();
+  // draw whatever was published after the last render
+  uint32_t frame = 0;
+  const RGBColor *leds = m_snapshot.acquire(frame);
+  if (leds) {
+    countRendered(frame);
+    renderFrame(leds);
+  }
+  // put the cursor back under the box
+  m_terminal.finish();
+  writeOutput(m_terminal.data(), m_terminal.size());
+}
+
+void TestFramework::renderLoop()
+{
+  chrono::nanoseconds period(1000000000 / m_renderFps);
+  chrono::steady_clock::time_point next = chrono::steady_clock::now();
+  // the ticks and render times since the last hud update, the first one is
+  // after a full interval so there's a rate to show
+  chrono::steady_clock::time_point lastHud = next;
+  chrono::steady_clock::time_point nextHud = next + chrono::milliseconds(HUD_INTERVAL_MS);
+  uint32_t hudTicks = m_hudTicks.load(memory_order_relaxed);
+  uint64_t renderTime = 0;
+  uint32_t renders = 0;
+  size_t renderBytes = 0;
+  while (m_rendering.load(memory_order_relaxed)) {
+    if (outputBackedUp()) {
+      // the terminal hasn't caught up yet, leave the frame in the snapshot so
+      // the next redraw picks up whatever is newest by then
+      m_backedUpRenders++;
+      m_heldFrame = m_publishedFrame.load(memory_order_relaxed);
+    } else {
+      uint32_t frame = 0;
+      const RGBColor *leds = m_snapshot.acquire(frame);
+      if (leds) {
+        countRendered(frame);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        renderFrame(leds);
+        renderTime += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        renderBytes += m_terminal.size();
+        renders++;
+      }
+    }
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (m_hud && now >= nextHud) {
+      chrono::nanoseconds interval = chrono::milliseconds(HUD_INTERVAL_MS);
+      // the updates can be late so the rate is over the time that really passed
+      double secs = chrono::duration<double>(now - lastHud).count();
+      uint32_t ticks = m_hudTicks.load(memory_order_relaxed);
+      drawHud((ticks - hudTicks) / secs, renders ? (renderTime / renders) : 0,
+        renders ? (renderBytes / renders) : 0);
+      lastHud = now;
+      hudTicks = ticks;
+      renderTime = 0;
+      renders = 0;
+      renderBytes = 0;
+      nextHud += interval;
+    }
+    // don't try to catch up on missed frames, just wait for the next one
+    next += period;
+    now = chrono::steady_clock::now();
+    if (next < now) {
+      next = now;
+    }
+    this_thread::sleep_until(next);
+  }
+}
+
+void TestFramework::countRendered(uint32_t frame)
+{
+  // of the frames published since the last one drawn, the ones up to the
+  // held back frame would have been drawn if the terminal kept up, the rest
+  // were never going to be drawn at this fps
+  if (m_framesRendered && frame > m_lastRenderedFrame + 1) {
+    uint32_t held = min(max(m_heldFrame, m_lastRenderedFrame), frame - 1);
+    m_framesDropped += held - m_lastRenderedFrame;
+    m_framesSkipped += (frame - 1) - held;
+  }
+  m_lastRenderedFrame = frame;
+  m_framesRendered++;
+}
+
+void TestFramework::drawHud(double ticksPerSec, uint64_t renderTime, size_t renderBytes)
+{
+  char target[16] = "max";
+  uint32_t targetRate = m_hudTarget.load(memory_order_relaxed);
+  if (targetRate) {
+    snprintf(target, sizeof(target), "%u", targetRate);
+  }
+  // what the engine hasn't read yet plus what is still waiting to go to it
+  int queued = 0;
+  ioctl(STDIN_FILENO, FIONREAD, &queued);
+  uint32_t pending = m_hudPending.load(memory_order_relaxed) + queued;
+  char text[256];
+  snprintf(text, sizeof(text), " %.0f/%s tps | render %.1fus %zuB | dropped %u skipped %u | input %u | %s | lock %s",
+    ticksPerSec, target, renderTime / 1000.0, renderBytes, m_framesDropped, m_framesSkipped, pending,
+    m_hudSleeping.load(memory_order_relaxed) ? "asleep" : "awake", m_lockEnabled ? "on" : "off");
+  m_terminal.drawHud(text);
+  writeOutput(m_terminal.data(), m_terminal.size());
+}
+
+bool TestFramework::outputBackedUp()
+{
+  // stdout can't take any more right now
+  struct pollfd pfd = { STDOUT_FILENO, POLLOUT, 0 };
+  if (poll(&pfd, 1, 0) == 0) {
+    return true;
+  }
+  // or the terminal is still sitting on too much output
+  int queued = 0;
+  if (ioctl(STDOUT_FILENO, TIOCOUTQ, &queued) == 0 && queued > RENDER_BACKLOG_BYTES) {
+    return true;
+  }
+  return false;
+}
+#endif
+
+void TestFramework::writeOutput(const void *data, size_t len)
+{
+  m_output.write(data, len);
+}
+
+void TestFramework::printOutputStats()
+{
+#ifndef WASM
+  printTickStats();
+#endif
+  if (m_fastForward) {
+    fprintf(stderr, "Fast-forward: %" PRIu64 " of %u ticks predicted in %" PRIu64 " waits\n",
+      m_ffTicks, m_frameCount, m_ffSkips);
+  }
+  if (m_idleWaits) {
+    fprintf(stderr, "Idle: %" PRIu64 " waits for %.3fms\n", m_idleWaits, m_idleTime / 1000000.0);
+  }
+  if (m_headless) {
+    double ms = m_headlessTime / 1000000.0;
+    fprintf(stderr, "Headless: %u ticks in %.3fms (%.0f ticks/sec), %u frames captured\n",
+      m_frameCount, ms, ms ? (m_frameCount * 1000.0) / ms : 0.0, m_frames.numFrames());
+  }
+  if (m_inPlace) {
+    fprintf(stderr, "Output: %u frames, %u drawn, %u skipped by the %u fps redraws, %u dropped while backed up, %u redraws skipped for backpressure\n",
+      m_frameCount, m_framesRendered, m_framesSkipped, m_renderFps, m_framesDropped, m_backedUpRenders);
+  }
+  // the writers are already cleaned up but only the ones with a ring had a thread
+  if (m_output.capacity()) {
+    fprintf(stderr, "Output: %" PRIu64 " bytes in %" PRIu64 " writes, ring high-water %zu/%zu bytes, %" PRIu64 " stalls\n",
+      m_output.bytesWritten(), m_output.numSyscalls(), m_output.highWater(), m_output.capacity(), m_output.numStalls());
+  }
+  if (m_fileOutput.capacity()) {
+    fprintf(stderr, "File: %" PRIu64 " bytes in %" PRIu64 " writes, ring high-water %zu/%zu bytes, %" PRIu64 " stalls\n",
+      m_fileOutput.bytesWritten(), m_fileOutput.numSyscalls(), m_fileOutput.highWater(), m_fileOutput.capacity(), m_fileOutput.numStalls());
+  }
+}
+
+void TestFramework::flushRepeat()
+{
+  if (!m_repeatCount) {
+    return;
+  }
+  m_sink.write(m_lastFrame, m_numLeds, m_repeatCount);
+  m_repeatCount = 0;
+}
+
+void TestFramework::writeBinaryHeader()
+{
+  BinaryFrameHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BINARY_FRAMES_MAGIC, sizeof(header.magic));
+  header.version = BINARY_FRAMES_VERSION;
+  header.format = m_binaryFormat;
+  header.numLeds = htole16((uint16_t)m_numLeds);
+  header.tickrate = htole32(Vortex::getTickrate());
+  if (m_binaryFormat == BINARY_FORMAT_FRAMES && m_filterFrames) {
+    // without the filters the tick is just the count of frames before it
+    header.flags = htole32(BINARY_FLAG_TICKS);
+  }
+  writeOutput(&header, sizeof(header));
+}
+
+void TestFramework::showBinary(const RGBColor *leds, uint32_t frame)
+{
+  m_encoder.clear();
+  if (m_binaryFormat == BINARY_FORMAT_FRAMES) {
+    if (m_filterFrames) {
+      uint32_t tick = htole32(frame);
+      m_encoder.append((const char *)&tick, sizeof(tick));
+    }
+    m_encoder.appendRGB(leds, m_numLeds);
+  } else {
+    // only the leds that changed since the last frame, or all on the first
+    for (uint32_t i = 0; i < m_numLeds; ++i) {
+      if (m_framesKept > 1 && m_lastFrame[i].raw() == leds[i].raw()) {
+        continue;
+      }
+      BinaryLedEvent event = { htole32(frame), (uint8_t)i, leds[i].red, leds[i].green, leds[i].blue };
+      m_encoder.append((const char *)&event, sizeof(event));
+      m_lastFrame[i] = leds[i];
+    }
+  }
+  if (m_encoder.size()) {
+    writeOutput(m_encoder.data(), m_encoder.size());
+  }
+}
+
+bool TestFramework::isButtonPressed() const
+{
+  return Vortex::isButtonPressed();
+}
+
+bool TestFramework::stillRunning() const
+{
+  return (m_initialized && m_keepGoing);
+}
+
+void TestFramework::installLeds(CRGB *leds, uint32_t count)
+{
+  m_ledList = (RGBColor *)leds;
+  m_numLeds = count;
+  // size the frame buffer once so that show() never allocates, the extra
+  // bytes are for the newline and repeat count
+  m_encoder.init(m_numLeds, 32);
+  if (m_inPlace) {
+    m_terminal.init(m_numLeds, m_outputType == OUTPUT_TYPE_HEX, m_layout,
+      input_usage, input_usage_brief, NUM_USAGE);
+    m_terminal.setPalette(&m_palette);
+  }
+  // the frames passed to the render thread
+  m_snapshot.init(m_numLeds);
+  // the previous frame for the repeat detection
+  if (m_lastFrame) {
+    delete[] m_lastFrame;
+  }
+  m_lastFrame = new RGBColor[m_numLeds];
+}
+
+long TestFramework::TestFrameworkCallbacks::checkPinHook(uint32_t pin)
+{
+  if (pin == 20) {
+    // orbit button 2
+    return Vortex::isButtonPressed(1) ? 0 : 1;
+  }
+  return Vortex::isButtonPressed(0) ? 0 : 1;
+}
+
+void TestFramework::TestFrameworkCallbacks::ledsInit(void *cl, int count)
 {
   g_pTestFramework->installLeds((CRGB *)cl, count);
 }
 
+void TestFramework::TestFrameworkCallbacks::infraredWrite(bool mark, uint32_t amount)
+{
+#ifndef WASM
+  g_pTestFramework->sendIR(mark, amount);
+#endif
+}
+
+bool TestFramework::TestFrameworkCallbacks::serialCheck()
+{
+  return g_pTestFramework->m_serialFd >= 0;
+}
+
+int32_t TestFramework::TestFrameworkCallbacks::serialAvail()
+{
+  return (int32_t)g_pTestFramework->m_serialBuffer.size();
+}
+
+size_t TestFramework::TestFrameworkCallbacks::serialRead(char *buf, size_t amt)
+{
+  string &buffer = g_pTestFramework->m_serialBuffer;
+  if (amt > buffer.size()) {
+    amt = buffer.size();
+  }
+  memcpy(buf, buffer.data(), amt);
+  buffer.erase(0, amt);
+  return amt;
+}
+
+uint32_t TestFramework::TestFrameworkCallbacks::serialWrite(const uint8_t *buf, size_t len)
+{
+  int fd = g_pTestFramework->m_serialFd;
+  if (fd < 0) {
+    return 0;
+  }
+  ssize_t amt = write(fd, buf, len);
+  return (amt > 0) ? (uint32_t)amt : 0;
+}
+
 void TestFramework::TestFrameworkCallbacks::ledsShow()
 {
   g_pTestFramework->show();
@@ -1,7 +1,34 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+
 #include "VortexLib.h"
 
+#include "FrameEncoder.h"
+#include "ColorPalette.h"
+#include "BinaryFrames.h"
+#include "FrameSnapshot.h"
+#include "FrameBuffer.h"
+#include "OutputWriter.h"
+#include "OutputSink.h"
+#include "TerminalRenderer.h"
+#include "LatencyHistogram.h"
+#include "PeriodDetector.h"
+#include "TickProfiler.h"
+#include "TraceWriter.h"
+#include "RuntimeMetrics.h"
+#include "InputScript.h"
+#include "InputFile.h"
+#include "InputRecording.h"
+#include "CommandLogWriter.h"
+#include "UntilCondition.h"
+#ifndef WASM
+#include "EventReactor.h"
+#endif
+
 #include "Patterns/Patterns.h"
 #include "Colors/ColorTypes.h"
 #include "Colors/Colorset.h"
@@ -21,6 +48,8 @@ typedef struct tagCRGB CRGB;
 
 // paint callback type
 typedef void (*paint_fn_t)(void *, HDC);
+// callback for the frames of a headless run
+typedef void (*frames_fn_t)(void *, const FrameBuffer &);
 
 class TestFramework
 {
@@ -31,6 +60,9 @@ public:
   // initialize the test framework
   bool init(int argc, char *argv[]);
 
+  // block while the engine has nothing to do (asleep or lockstep waiting
+  // for input) so it isn't ticked nonstop
+  void wait();
   // run the test framework
   void run();
   void cleanup();
@@ -44,6 +76,9 @@ public:
   // whether the test framework is still running
   bool stillRunning() const;
 
+  // what the process exits with, a failure if the --until was never met
+  int exitCode() const { return m_exitCode; }
+
   // setup the array of leds
   void installLeds(CRGB *leds, uint32_t count);
 
@@ -53,6 +88,9 @@ public:
   void setHexOutput(bool output) { m_outputType = OUTPUT_TYPE_HEX; }
   void setNoTimestep(bool timestep) { m_noTimestep = timestep; }
   void setInPlace(bool inplace) { m_inPlace = inplace; }
+  // when embedded, receive the frames of a headless run instead of them
+  // being written to the output
+  void setFramesCallback(frames_fn_t callback, void *arg) { m_framesCallback = callback; m_framesArg = arg; }
 
 private:
   class TestFrameworkCallbacks : public VortexCallbacks
@@ -61,14 +99,134 @@ private:
     TestFrameworkCallbacks() {}
     virtual ~TestFrameworkCallbacks() {}
     virtual long checkPinHook(uint32_t pin) override;
+    virtual void infraredWrite(bool mark, uint32_t amount) override;
+    virtual bool serialCheck() override;
+    virtual int32_t serialAvail() override;
+    virtual size_t serialRead(char *buf, size_t amt) override;
+    virtual uint32_t serialWrite(const uint8_t *buf, size_t len) override;
     virtual void ledsInit(void *cl, int count) override;
     virtual void ledsShow() override;
   private:
     // receive a message from client
   };
 
-  // internal helper for updating terminal size
-  void get_terminal_size();
+  // count a frame and send it through the filters to the frame buffer or
+  // the outputs, the frames predicted by --fast-forward come in here too
+  void emitFrame(const RGBColor *leds);
+  // tick the engine, timing it for --profile and --trace
+  bool tickEngine();
+  // add the events of a tick and a frame to the --trace timeline
+  void traceTick(uint32_t tick, uint64_t start, uint64_t end);
+  void traceLeds(uint64_t time);
+  void traceCommands(const char *data, size_t len, uint64_t time);
+  // bring the metrics that are slow to collect up to date
+  void pollMetrics(uint64_t now);
+  // the total bytes written to stdout and the --output file
+  uint64_t bytesWritten() const;
+  // send a frame through the binary, in-place and sink outputs
+  void outputFrame(const RGBColor *leds, uint32_t frame);
+  // tick as fast as possible collecting the frames then write them all
+  void runHeadless();
+  void writeFrames();
+  // draw a frame of leds in-place
+  void renderFrame(const RGBColor *leds);
+  // bind the sink that show() writes frames to
+  bool setupSinks();
+  // compile the --until and check it against each frame as it comes in
+  bool setupUntil();
+  void checkUntil(const RGBColor *leds, uint32_t frame);
+  void dumpUntil(const RGBColor *leds, uint32_t frame);
+
+#ifndef WASM
+  // the event reactor that wait() sleeps in and everything it listens to
+  bool setupReactor();
+  bool setupIR();
+  // pace the ticks with the reactor timer
+  void startTimestep();
+  // drop the feeds and let stdin drive in real time once the --until is met
+  void startInteractive();
+  // put a pipe in front of the engine's stdin, and undo it
+  bool redirectInput();
+  void restoreInput();
+  // the --fast-forward input feed, returns true when the frames of a wait
+  // were predicted instead of running the tick
+  bool setupFastForward();
+  bool fastForward();
+  uint32_t predictWait();
+  void readFastForwardInput();
+  void queueFastForwardInput();
+  // load the --script or --input-file and hand it to the engine as it gets
+  // through it
+  bool setupFeed();
+  bool feedDone() const;
+  const char *nextFeed(char *buf, size_t size, uint32_t maxRepeat, size_t &len, uint64_t &ticks);
+  static uint64_t countTicks(const char *data, size_t len);
+  void feedInput();
+  void writeFeed(const char *data, size_t len);
+  // the --replay and --record-ticks of the inputs with their ticks
+  bool replayInput();
+  // write input into the engine's pipe, stdin passed through when it's being
+  // recorded, and the recording of everything that goes into the pipe
+  void writeInput(const char *data, size_t len);
+  void passInput();
+  void captureInput(const char *data, size_t len);
+  static bool printRecordingInput(const char *filename);
+  void cleanupReactor();
+  void handleInput(int fd, uint32_t events);
+  void forwardInput();
+  void handleIR(int fd, uint32_t events);
+  void handleSerial(int fd, uint32_t events);
+  void sendIR(bool mark, uint32_t amount);
+  // measure a tick against the schedule and work out the next deadline
+  void scheduleTick(uint64_t now);
+  // change the multiple of real time the ticks run at
+  void setSpeed(double speed);
+  void raisePriority();
+  void printTickStats();
+  static void inputCallback(void *arg, int fd, uint32_t events) {
+    ((TestFramework *)arg)->handleInput(fd, events);
+  }
+  static void pipeCallback(void *arg, int fd, uint32_t events) {
+    ((TestFramework *)arg)->forwardInput();
+  }
+  static void irCallback(void *arg, int fd, uint32_t events) {
+    ((TestFramework *)arg)->handleIR(fd, events);
+  }
+  static void serialCallback(void *arg, int fd, uint32_t events) {
+    ((TestFramework *)arg)->handleSerial(fd, events);
+  }
+
+  // the thread that draws the in-place output
+  void startRenderThread();
+  void stopRenderThread();
+  void renderLoop();
+  // count the frames published since the last one drawn as dropped or skipped
+  void countRendered(uint32_t frame);
+  // whether the terminal is too far behind to take another frame
+  bool outputBackedUp();
+  // SIGUSR1, the metrics socket thread and the storage file watch
+  void dumpMetrics();
+  bool startMetrics();
+  void stopMetrics();
+  void metricsLoop();
+  uint64_t countStorageSaves();
+  // update the --hud line from the render thread
+  void drawHud(double ticksPerSec, uint64_t renderTime, size_t renderBytes);
+#endif
+
+  // write bytes of output to stdout, through the writer thread if there is one
+  void writeOutput(const void *data, size_t len);
+  void printOutputStats();
+
+  // whether a frame passes the --every and tick filters
+  bool keepFrame(uint32_t frame);
+
+  // print the frame that is being counted by the repeat mode
+  void flushRepeat();
+
+  // write the header and frames of the --binary output
+  void writeBinaryHeader();
+  void showBinary(const RGBColor *leds, uint32_t frame);
 
   // these are in no particular order
   RGBColor *m_ledList;
@@ -83,11 +241,15 @@ private:
     OUTPUT_TYPE_NONE,
     OUTPUT_TYPE_HEX,
     OUTPUT_TYPE_COLOR,
+    OUTPUT_TYPE_BINARY,
+    OUTPUT_TYPE_NULL,
   };
   OutputType m_outputType;
+  BinaryFrameFormat m_binaryFormat;
   bool m_noTimestep;
   bool m_lockstep;
   bool m_inPlace;
+  bool m_repeatFrames;
   bool m_record;
   bool m_storage;
   bool m_sleepEnabled;
@@ -96,10 +258,178 @@ private:
   std::string m_patternIDStr;
   std::string m_colorsetStr;
   std::string m_argumentsStr;
+  std::string m_colorModeStr;
+  std::string m_outputFile;
   // to pipe stuff into the engine
   int m_pipe_fd[2];
   int m_saved_stdin;
+  // when stdin is a file the reactor can't wait on
+  bool m_readStdin;
   std::string m_inputBuffer;
+  // preallocated buffer that the binary frames are packed into
+  FrameEncoder m_encoder;
+  // the 256 or 16 color lookup for the color output
+  ColorPalette m_palette;
+  // the last frame and how many times in a row it was shown (repeat mode)
+  RGBColor *m_lastFrame;
+  uint32_t m_repeatCount;
+  // the number of frames that have been shown
+  uint32_t m_frameCount;
+  // the number of frames that made it through the filters
+  uint32_t m_framesKept;
+  // the --every, --from-tick, --to-tick and --at-ticks filters
+  bool m_filterFrames;
+  uint32_t m_every;
+  uint32_t m_fromTick;
+  uint32_t m_toTick;
+  std::vector<uint32_t> m_atTicks;
+  size_t m_nextAtTick;
+  // the headless run, no max ticks runs until the input quits
+  bool m_headless;
+  bool m_captureFrames;
+  uint32_t m_maxTicks;
+  FrameBuffer m_frames;
+  frames_fn_t m_framesCallback;
+  void *m_framesArg;
+  uint64_t m_headlessTime;
+  // the --until condition, what happens when it's met, the tick it gives up
+  // on and whether it held on the last frame
+  UntilCondition m_until;
+  std::string m_untilExpr;
+  enum UntilAction {
+    UNTIL_STOP,
+    UNTIL_DUMP,
+    UNTIL_INTERACTIVE,
+  };
+  UntilAction m_untilAction;
+  uint32_t m_untilMax;
+  bool m_untilWatching;
+  bool m_untilMet;
+  uint32_t m_untilCount;
+  // set on the frame that stops the run or hands it over to stdin
+  bool m_untilStop;
+  bool m_untilInteractive;
+  int m_exitCode;
+  // whether the last tick showed a frame, and the time spent blocked in wait()
+  bool m_tickShowed;
+  uint64_t m_idleWaits;
+  uint64_t m_idleTime;
+#ifndef WASM
+  EventReactor m_reactor;
+#endif
+  bool m_useReactor;
+  // set when input is forwarded to the engine
+  bool m_inputArrived;
+  // the time between ticks when the reactor paces them, 0 for no timestep
+  uint64_t m_tickPeriod;
+  // the deadline of the next tick on the schedule
+  uint64_t m_nextTick;
+  // the --tickrate and --priority options
+  uint32_t m_tickrate;
+  bool m_priority;
+  // the --speed multiple and the tick period at 1x that it divides
+  double m_speed;
+  uint64_t m_baseTickPeriod;
+  // the --fast-forward input that hasn't been given to the engine, how many
+  // ticks of commands the engine still has queued and of the current wait
+  bool m_fastForward;
+  std::string m_ffInput;
+  bool m_ffInputDone;
+  uint32_t m_ffBacklog;
+  uint32_t m_ffWait;
+  uint32_t m_ffCheckIn;
+  PeriodDetector m_periods;
+  uint64_t m_ffTicks;
+  uint64_t m_ffSkips;
+  // the --script or --input-file and how many ticks of it the engine still
+  // has queued
+  InputScript m_script;
+  std::string m_scriptFile;
+  InputFile m_inputFile;
+  std::string m_inputFileName;
+  uint64_t m_feedBacklog;
+  // the --record-ticks and the recording being replayed
+  InputRecording m_recording;
+  std::string m_recordingFile;
+  // where --record streams the inputs to and whether stdin is passed through
+  // to the engine so it can be
+  std::string m_recordFile;
+  CommandLogWriter m_recordLog;
+  bool m_passthrough;
+  InputRecording m_replay;
+  std::string m_replayFile;
+  // the --profile timings and the time spent in show() during this tick
+  bool m_profiling;
+  bool m_profileJson;
+  TickProfiler m_profiler;
+  uint64_t m_showTime;
+  // the --trace timeline and the leds and button as of the last events
+  std::string m_traceFile;
+  TraceWriter m_trace;
+  RGBColor *m_traceLeds;
+  bool m_tracePressed;
+  std::string m_traceArgs;
+  // how late each tick started and how many fell a whole tick or more behind
+  LatencyHistogram m_tickLateness;
+  uint64_t m_tickOverruns;
+  uint64_t m_ticksSkipped;
+  // the control fifo, IR socket and serial device
+  std::string m_controlPath;
+  int m_controlFd;
+  std::string m_irPath;
+  int m_irListenFd;
+  int m_irFd;
+  std::string m_irBuffer;
+  std::string m_serialPath;
+  int m_serialFd;
+  std::string m_serialBuffer;
+  // the latest frame handed from the engine to the render thread
+  FrameSnapshot m_snapshot;
+  std::thread m_renderThread;
+  std::atomic<bool> m_rendering;
+  uint32_t m_renderFps;
+  // the writer thread for everything that isn't in-place
+  OutputWriter m_output;
+  // the writer thread for the --output file
+  OutputWriter m_fileOutput;
+  // where show() writes frames, unbound for the null output
+  OutputSink m_sink;
+  bool m_outputStats;
+  // render thread counters for the in-place output, only the render thread
+  // touches them while it runs and they are read after it's been joined
+  uint32_t m_framesRendered;
+  // frames that were replaced while the terminal was backed up, and the ones
+  // that were only replaced because they came between two redraws
+  uint32_t m_framesDropped;
+  uint32_t m_framesSkipped;
+  uint32_t m_backedUpRenders;
+  uint32_t m_lastRenderedFrame;
+  // the newest frame that was held back while the terminal was backed up
+  uint32_t m_heldFrame;
+  // the newest frame the tick thread published for the render thread
+  std::atomic<uint32_t> m_publishedFrame;
+  // the --hud line, the tick thread shares what it knows through these
+  bool m_hud;
+  std::atomic<bool> m_hudSleeping;
+  std::atomic<uint32_t> m_hudTicks;
+  std::atomic<uint32_t> m_hudPending;
+  std::atomic<uint32_t> m_hudTarget;
+  // the counters that can be looked at while running, the button they
+  // have seen and when to poll them next
+  RuntimeMetrics m_metrics;
+  bool m_metricsPressed;
+  uint64_t m_nextMetricsPoll;
+  // the --metrics-socket and the thread that answers it
+  std::string m_metricsPath;
+  int m_metricsFd;
+  std::thread m_metricsThread;
+  std::atomic<bool> m_metricsServing;
+  // the inotify watch that counts the storage saves
+  int m_storageWatchFd;
+  std::string m_storageName;
+  // draws the in-place output
+  TerminalRenderer m_terminal;
+  TerminalRenderer::Layout m_layout;
 };
 
 extern TestFramework *g_pTestFramework;
@@ -0,0 +1,85 @@
+#include "TickProfiler.h"
+
+#include <chrono>
+
+using namespace std;
+
+TickProfiler::TickProfiler() :
+  m_phases(),
+  m_ticks(0),
+  m_start(0),
+  m_end(0)
+{
+}
+
+uint64_t TickProfiler::now()
+{
+  return chrono::duration_cast<chrono::nanoseconds>(
+    chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TickProfiler::print(FILE *out) const
+{
+  double secs = seconds();
+  fprintf(out, "Profile: %" PRIu64 " ticks in %.3fs (%.0f ticks/sec)\n",
+    m_ticks, secs, secs ? m_ticks / secs : 0.0);
+  fprintf(out, "  %-16s %10s %8s %8s %8s %8s %8s\n", "phase", "count", "p50", "p90", "p99", "max", "total");
+  for (uint32_t i = 0; i < NUM_PHASES; ++i) {
+    const LatencyHistogram &phase = m_phases[i];
+    if (!phase.count()) {
+      continue;
+    }
+    fprintf(out, "  %-16s %10" PRIu64 " ", phaseName((Phase)i), phase.count());
+    printDuration(out, phase.percentile(50));
+    fputc(' ', out);
+    printDuration(out, phase.percentile(90));
+    fputc(' ', out);
+    printDuration(out, phase.percentile(99));
+    fputc(' ', out);
+    printDuration(out, phase.max());
+    fputc(' ', out);
+    printDuration(out, phase.total());
+    fputc('\n', out);
+  }
+}
+
+void TickProfiler::printJson(FILE *out) const
+{
+  double secs = seconds();
+  fprintf(out, "{\"ticks\":%" PRIu64 ",\"seconds\":%.6f,\"ticks_per_sec\":%.1f,\"phases\":{",
+    m_ticks, secs, secs ? m_ticks / secs : 0.0);
+  bool first = true;
+  for (uint32_t i = 0; i < NUM_PHASES; ++i) {
+    const LatencyHistogram &phase = m_phases[i];
+    if (!phase.count()) {
+      continue;
+    }
+    fprintf(out, "%s\"%s\":{\"count\":%" PRIu64 ",\"p50_ns\":%" PRIu64 ",\"p90_ns\":%" PRIu64
+      ",\"p99_ns\":%" PRIu64 ",\"max_ns\":%" PRIu64 ",\"total_ns\":%" PRIu64 "}",
+      first ? "" : ",", phaseName((Phase)i), phase.count(), phase.percentile(50),
+      phase.percentile(90), phase.percentile(99), phase.max(), phase.total());
+    first = false;
+  }
+  fprintf(out, "}}\n");
+}
+
+const char *TickProfiler::phaseName(Phase phase)
+{
+  switch (phase) {
+  case PHASE_INIT: return "init";
+  case PHASE_STORAGE: return "storage";
+  case PHASE_ENGINE: return "engine";
+  case PHASE_SHOW: return "show";
+  case PHASE_WRITE: return "write";
+  case PHASE_FILE_WRITE: return "file_write";
+  case PHASE_HEADLESS_OUTPUT: return "headless_output";
+  default: break;
+  }
+  return "unknown";
+}
+
+double TickProfiler::seconds() const
+{
+  uint64_t end = m_end ? m_end : now();
+  return m_start ? (end - m_start) / 1000000000.0 : 0.0;
+}
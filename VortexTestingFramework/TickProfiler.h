@@ -0,0 +1,59 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "LatencyHistogram.h"
+
+// This times the phases of a run for --profile: the startup of the engine,
+// each engine tick, the framework work in show() and every write syscall of
+// the output. Each phase is a histogram so a summary of percentiles can be
+// printed at exit, either as a table or as json for tracking regressions
+
+class TickProfiler
+{
+public:
+  enum Phase {
+    // Vortex::init and loading the storage file
+    PHASE_INIT,
+    PHASE_STORAGE,
+    // the time in Vortex::tick() that isn't spent in show()
+    PHASE_ENGINE,
+    // the framework part of each tick, formatting and handing off the frame
+    PHASE_SHOW,
+    // the syscalls that write the output and the --output file, these are
+    // on the writer threads unless the output is written directly
+    PHASE_WRITE,
+    PHASE_FILE_WRITE,
+    // formatting and writing all the frames at the end of a headless run
+    PHASE_HEADLESS_OUTPUT,
+
+    NUM_PHASES
+  };
+
+  TickProfiler();
+
+  // the current monotonic time in nanoseconds
+  static uint64_t now();
+
+  // mark the start and end of the ticking for the ticks per second
+  void start() { m_start = now(); }
+  void stop() { m_end = now(); }
+  void countTick() { m_ticks++; }
+
+  void record(Phase phase, uint64_t ns) { m_phases[phase].record(ns); }
+  // for the writers to record into from their own thread
+  LatencyHistogram *phase(Phase phase) { return m_phases + phase; }
+
+  void print(FILE *out) const;
+  void printJson(FILE *out) const;
+
+private:
+  static const char *phaseName(Phase phase);
+  double seconds() const;
+
+  LatencyHistogram m_phases[NUM_PHASES];
+  uint64_t m_ticks;
+  uint64_t m_start;
+  uint64_t m_end;
+};
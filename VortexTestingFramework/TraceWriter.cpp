@@ -0,0 +1,103 @@
+#include "TraceWriter.h"
+#include "TickProfiler.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <stdio.h>
+
+// the ring the events are buffered in before the writer thread writes them
+#define TRACE_RING_SIZE (1024 * 1024)
+
+// enough for the fixed part of any event, the args are written separately
+#define TRACE_EVENT_SIZE 256
+
+TraceWriter::TraceWriter() :
+  m_writer(),
+  m_fd(-1),
+  m_start(0)
+{
+}
+
+TraceWriter::~TraceWriter()
+{
+  cleanup();
+}
+
+bool TraceWriter::init(const char *filename)
+{
+  cleanup();
+  m_fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (m_fd < 0) {
+    return false;
+  }
+#ifndef WASM
+  m_writer.init(m_fd, TRACE_RING_SIZE);
+#else
+  m_writer.init(m_fd, 0);
+#endif
+  m_start = TickProfiler::now();
+  const char *header = "{\"traceEvents\":[\n";
+  m_writer.write(header, strlen(header));
+  // name the process and thread so the timeline is labelled
+  const char *names =
+    "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"vortex\"}},\n"
+    "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"engine\"}}";
+  m_writer.write(names, strlen(names));
+  return true;
+}
+
+void TraceWriter::cleanup()
+{
+  if (m_fd < 0) {
+    return;
+  }
+  const char *footer = "\n],\"displayTimeUnit\":\"ms\"}\n";
+  m_writer.write(footer, strlen(footer));
+  m_writer.cleanup();
+  close(m_fd);
+  m_fd = -1;
+}
+
+void TraceWriter::span(const char *name, uint64_t start, uint64_t end,
+  const char *argName, const char *argValue)
+{
+  if (m_fd < 0) {
+    return;
+  }
+  char args[TRACE_EVENT_SIZE];
+  if (argName) {
+    snprintf(args, sizeof(args), "{\"%s\":%s}", argName, argValue);
+  }
+  writeEvent(name, 'X', start, end - start, argName ? args : nullptr);
+}
+
+void TraceWriter::instant(const char *name, uint64_t time, const char *args)
+{
+  if (m_fd < 0) {
+    return;
+  }
+  writeEvent(name, 'i', time, 0, args);
+}
+
+void TraceWriter::writeEvent(const char *name, char phase, uint64_t time, uint64_t duration, const char *args)
+{
+  // the timestamps are microseconds but keep the nanoseconds as a fraction
+  uint64_t ts = (time > m_start) ? (time - m_start) : 0;
+  char event[TRACE_EVENT_SIZE];
+  int len = snprintf(event, sizeof(event), ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%03" PRIu64
+    ",\"pid\":1,\"tid\":1", name, phase, ts / 1000, ts % 1000);
+  if (phase == 'X') {
+    len += snprintf(event + len, sizeof(event) - len, ",\"dur\":%" PRIu64 ".%03" PRIu64,
+      duration / 1000, duration % 1000);
+  } else {
+    // instant events are scoped to the thread
+    len += snprintf(event + len, sizeof(event) - len, ",\"s\":\"t\"");
+  }
+  m_writer.write(event, len);
+  if (args) {
+    m_writer.write(",\"args\":", 8);
+    m_writer.write(args, strlen(args));
+  }
+  m_writer.write("}", 1);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "OutputWriter.h"
+
+// This writes a timeline of the run in the chrome trace event format for
+// --trace, the file loads directly in Perfetto or chrome://tracing. Every
+// event is one short json object that is formatted into a fixed buffer and
+// handed to an OutputWriter, so the tick thread only does a memcpy into the
+// ring and the writer thread does the file writes in large batches
+
+class TraceWriter
+{
+public:
+  TraceWriter();
+  ~TraceWriter();
+
+  bool init(const char *filename);
+  // close the list of events and the file
+  void cleanup();
+
+  bool isActive() const { return m_fd >= 0; }
+
+  // a span of time on the engine thread, the times are from TickProfiler::now
+  // and the optional argument is a json value like 12 or "abc"
+  void span(const char *name, uint64_t start, uint64_t end,
+    const char *argName = nullptr, const char *argValue = nullptr);
+  // a point in time, the args are a json object or nullptr
+  void instant(const char *name, uint64_t time, const char *args = nullptr);
+
+private:
+  void writeEvent(const char *name, char phase, uint64_t time, uint64_t duration, const char *args);
+
+  OutputWriter m_writer;
+  int m_fd;
+  // the time of the start of the trace, all events are relative to it
+  uint64_t m_start;
+};
@@ -0,0 +1,391 @@
+#include "UntilCondition.h"
+
+#include "Colors/ColorTypes.h"
+#include "Menus/Menus.h"
+#include "VortexLib.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+
+using namespace std;
+
+// the menus by the names they go by in the expressions
+static const struct
+{
+  const char *name;
+  MenuEntryID id;
+} g_menuNames[] = {
+  { "none", MENU_NONE },
+  { "randomizer", MENU_RANDOMIZER },
+  { "modesharing", MENU_MODE_SHARING },
+  { "editorconnection", MENU_EDITOR_CONNECTION },
+  { "colorselect", MENU_COLOR_SELECT },
+  { "patternselect", MENU_PATTERN_SELECT },
+  { "globalbrightness", MENU_GLOBAL_BRIGHTNESS },
+  { "factoryreset", MENU_FACTORY_RESET },
+};
+#define NUM_MENU_NAMES (sizeof(g_menuNames) / sizeof(g_menuNames[0]))
+
+UntilCondition::UntilCondition() :
+  m_ops(),
+  m_expr(),
+  m_numLeds(0),
+  m_lastLeds(nullptr),
+  m_watchChanges(false),
+  m_haveLast(false),
+  m_pos(nullptr),
+  m_depth(0),
+  m_maxDepth(0),
+  m_nesting(0),
+  m_error()
+{
+}
+
+UntilCondition::~UntilCondition()
+{
+  if (m_lastLeds) {
+    delete[] m_lastLeds;
+  }
+}
+
+bool UntilCondition::compile(const char *expr, uint32_t numLeds, string &error)
+{
+  m_ops.clear();
+  m_expr = expr;
+  m_numLeds = numLeds;
+  m_watchChanges = false;
+  m_haveLast = false;
+  m_pos = m_expr.c_str();
+  m_depth = 0;
+  m_maxDepth = 0;
+  m_nesting = 0;
+  bool ok = parseOr();
+  skipSpace();
+  if (ok && *m_pos) {
+    ok = fail("expected && or || between the conditions");
+  }
+  if (ok && m_maxDepth > MAX_STACK) {
+    ok = fail("the expression is too long");
+  }
+  if (!ok) {
+    m_ops.clear();
+    error = m_error;
+    return false;
+  }
+  if (m_watchChanges) {
+    if (m_lastLeds) {
+      delete[] m_lastLeds;
+    }
+    m_lastLeds = new RGBColor[m_numLeds];
+  }
+  return true;
+}
+
+bool UntilCondition::check(const RGBColor *leds, uint32_t tick)
+{
+  uint32_t stack[MAX_STACK];
+  uint32_t top = 0;
+  for (const Op &op : m_ops) {
+    uint32_t value = 0;
+    switch (op.type) {
+    case OP_LED:
+      value = leds[op.arg].raw();
+      break;
+    case OP_TICK:
+      value = tick;
+      break;
+    case OP_MENU:
+      // shifted up one so no menu is 0
+      value = (uint32_t)(Menus::curMenuID() + 1);
+      break;
+    case OP_IN_MENU:
+      value = Menus::checkInMenu();
+      break;
+    case OP_SLEEPING:
+      value = Vortex::isSleeping();
+      break;
+    case OP_PRESSED:
+      value = Vortex::isButtonPressed();
+      break;
+    case OP_CHANGED:
+      value = m_haveLast && memcmp(leds, m_lastLeds, m_numLeds * sizeof(RGBColor)) != 0;
+      break;
+    case OP_AND:
+      top--;
+      stack[top - 1] = (stack[top - 1] && stack[top]);
+      continue;
+    case OP_OR:
+      top--;
+      stack[top - 1] = (stack[top - 1] || stack[top]);
+      continue;
+    case OP_NOT:
+      stack[top - 1] = !stack[top - 1];
+      continue;
+    }
+    bool result = false;
+    switch (op.compare) {
+    case CMP_TRUE:
+      result = (value != 0);
+      break;
+    case CMP_EQ:
+      result = (value == op.value);
+      break;
+    case CMP_NE:
+      result = (value != op.value);
+      break;
+    case CMP_LT:
+      result = (value < op.value);
+      break;
+    case CMP_LE:
+      result = (value <= op.value);
+      break;
+    case CMP_GT:
+      result = (value > op.value);
+      break;
+    case CMP_GE:
+      result = (value >= op.value);
+      break;
+    }
+    stack[top++] = result;
+  }
+  if (m_watchChanges) {
+    memcpy(m_lastLeds, leds, m_numLeds * sizeof(RGBColor));
+    m_haveLast = true;
+  }
+  return stack[0] != 0;
+}
+
+const char *UntilCondition::menuName(int menuID)
+{
+  for (uint32_t i = 0; i < NUM_MENU_NAMES; ++i) {
+    if (g_menuNames[i].id == menuID) {
+      return g_menuNames[i].name;
+    }
+  }
+  return "unknown";
+}
+
+bool UntilCondition::parseOr()
+{
+  if (!parseAnd()) {
+    return false;
+  }
+  while (accept("||")) {
+    if (!parseAnd()) {
+      return false;
+    }
+    emit(OP_OR);
+  }
+  return true;
+}
+
+bool UntilCondition::parseAnd()
+{
+  if (!parseUnary()) {
+    return false;
+  }
+  while (accept("&&")) {
+    if (!parseUnary()) {
+      return false;
+    }
+    emit(OP_AND);
+  }
+  return true;
+}
+
+bool UntilCondition::parseUnary()
+{
+  bool negate = accept("!");
+  bool bracket = !negate && accept("(");
+  if (!negate && !bracket) {
+    return parseCompare();
+  }
+  // the parser recurses for these so there's a limit
+  if (m_nesting >= MAX_NESTING) {
+    return fail("the brackets are nested too deep");
+  }
+  m_nesting++;
+  if (negate) {
+    if (!parseUnary()) {
+      return false;
+    }
+    emit(OP_NOT);
+  } else {
+    if (!parseOr()) {
+      return false;
+    }
+    if (!accept(")")) {
+      return fail("missing ')'");
+    }
+  }
+  m_nesting--;
+  return true;
+}
+
+bool UntilCondition::parseCompare()
+{
+  skipSpace();
+  const char *start = m_pos;
+  while (isalnum(*m_pos) || *m_pos == '_') {
+    m_pos++;
+  }
+  string atom(start, m_pos - start);
+  if (atom.empty()) {
+    return fail("expected a condition");
+  }
+  if (atom == "led") {
+    if (!accept("[")) {
+      return fail("expected the index of the led like led[0]");
+    }
+    skipSpace();
+    char *end = nullptr;
+    unsigned long index = strtoul(m_pos, &end, 10);
+    if (end == m_pos) {
+      return fail("expected the index of the led like led[0]");
+    }
+    if (index >= m_numLeds) {
+      char msg[64];
+      snprintf(msg, sizeof(msg), "there are only %u leds", m_numLeds);
+      return fail(msg);
+    }
+    m_pos = end;
+    if (!accept("]")) {
+      return fail("missing ']'");
+    }
+    emit(OP_LED, (uint32_t)index);
+    return parseValue("led");
+  }
+  if (atom == "tick") {
+    emit(OP_TICK);
+    return parseValue("tick");
+  }
+  if (atom == "menu") {
+    // on its own it's whether the menus are open at all
+    skipSpace();
+    if (strncmp(m_pos, "==", 2) != 0 && strncmp(m_pos, "!=", 2) != 0) {
+      emit(OP_IN_MENU);
+      return true;
+    }
+    emit(OP_MENU);
+    return parseValue("menu");
+  }
+  if (atom == "sleeping") {
+    emit(OP_SLEEPING);
+  } else if (atom == "pressed") {
+    emit(OP_PRESSED);
+  } else if (atom == "frame_changed") {
+    m_watchChanges = true;
+    emit(OP_CHANGED);
+  } else {
+    m_pos = start;
+    return fail(("unknown condition '" + atom + "'").c_str());
+  }
+  skipSpace();
+  if ((*m_pos && strchr("=<>", *m_pos)) || strncmp(m_pos, "!=", 2) == 0) {
+    return fail((atom + " is true or false, use it on its own or with a !").c_str());
+  }
+  return true;
+}
+
+bool UntilCondition::parseValue(const char *atom)
+{
+  static const struct
+  {
+    const char *token;
+    Compare compare;
+  } compares[] = {
+    // the two character ones first so < doesn't match the start of <=
+    { "==", CMP_EQ }, { "!=", CMP_NE }, { "<=", CMP_LE }, { ">=", CMP_GE }, { "<", CMP_LT }, { ">", CMP_GT },
+  };
+  Op &op = m_ops.back();
+  for (uint32_t i = 0; op.compare == CMP_TRUE && i < sizeof(compares) / sizeof(compares[0]); ++i) {
+    if (accept(compares[i].token)) {
+      op.compare = compares[i].compare;
+    }
+  }
+  if (op.compare == CMP_TRUE) {
+    // alone it's just whether the value isn't 0
+    return true;
+  }
+  skipSpace();
+  if (op.type == OP_MENU) {
+    const char *start = m_pos;
+    string name;
+    while (isalnum(*m_pos) || *m_pos == '_') {
+      // the case and underscores don't matter, ModeSharing or mode_sharing
+      if (*m_pos != '_') {
+        name += (char)tolower(*m_pos);
+      }
+      m_pos++;
+    }
+    for (uint32_t i = 0; i < NUM_MENU_NAMES; ++i) {
+      if (name == g_menuNames[i].name) {
+        op.value = (uint32_t)(g_menuNames[i].id + 1);
+        return true;
+      }
+    }
+    m_pos = start;
+    return fail("expected the name of a menu like randomizer");
+  }
+  char *end = nullptr;
+  unsigned long value = 0;
+  if (op.type == OP_LED) {
+    // the colors are hex like everywhere else, with or without a # or 0x
+    if (*m_pos == '#') {
+      m_pos++;
+    }
+    value = strtoul(m_pos, &end, 16);
+  } else {
+    value = strtoul(m_pos, &end, 10);
+  }
+  if (end == m_pos || (op.type == OP_LED && value > 0xFFFFFF) || value > UINT32_MAX) {
+    char msg[64];
+    snprintf(msg, sizeof(msg), "expected a %s to compare %s with", (op.type == OP_LED) ? "color" : "number", atom);
+    return fail(msg);
+  }
+  m_pos = end;
+  op.value = (uint32_t)value;
+  return true;
+}
+
+bool UntilCondition::fail(const char *what)
+{
+  char msg[160];
+  snprintf(msg, sizeof(msg), "column %u: %s", (uint32_t)(m_pos - m_expr.c_str()) + 1, what);
+  m_error = msg;
+  return false;
+}
+
+void UntilCondition::skipSpace()
+{
+  while (isspace(*m_pos)) {
+    m_pos++;
+  }
+}
+
+bool UntilCondition::accept(const char *token)
+{
+  skipSpace();
+  size_t len = strlen(token);
+  if (strncmp(m_pos, token, len) != 0) {
+    return false;
+  }
+  m_pos += len;
+  return true;
+}
+
+void UntilCondition::emit(OpType type, uint32_t arg)
+{
+  // keep track of how deep the stack gets so it can't overflow when it runs
+  if (type < OP_AND) {
+    m_depth++;
+  } else if (type < OP_NOT) {
+    m_depth--;
+  }
+  if (m_depth > m_maxDepth) {
+    m_maxDepth = m_depth;
+  }
+  m_ops.push_back({ type, CMP_TRUE, arg, 0 });
+}
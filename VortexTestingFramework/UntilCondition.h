@@ -0,0 +1,111 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+class RGBColor;
+
+// This is the --until expression, a condition on the leds and the state of
+// the engine that is checked after every tick:
+//
+//   led[0]==FF0000 && !pressed
+//   menu==randomizer || (sleeping && tick>5000)
+//   frame_changed
+//
+// It's compiled once into a short list of ops that run on a little stack so
+// checking it each tick is only a handful of instructions and it can be used
+// to search at full --no-timestep speed
+
+class UntilCondition
+{
+public:
+  UntilCondition();
+  ~UntilCondition();
+
+  // compile the expression, on failure the error says what and where
+  bool compile(const char *expr, uint32_t numLeds, std::string &error);
+  bool isCompiled() const { return !m_ops.empty(); }
+  const std::string &expression() const { return m_expr; }
+
+  // whether the condition holds for the frame that was shown on this tick
+  bool check(const RGBColor *leds, uint32_t tick);
+
+  // the name that is used for a menu in the expressions
+  static const char *menuName(int menuID);
+
+private:
+  enum OpType : uint8_t
+  {
+    // read a value, compare it and push whether it passed
+    OP_LED,
+    OP_TICK,
+    OP_MENU,
+    OP_IN_MENU,
+    OP_SLEEPING,
+    OP_PRESSED,
+    OP_CHANGED,
+    // pop two and push the result
+    OP_AND,
+    OP_OR,
+    // replace the top
+    OP_NOT,
+  };
+
+  enum Compare : uint8_t
+  {
+    // on its own, whether the value isn't 0
+    CMP_TRUE,
+    CMP_EQ,
+    CMP_NE,
+    CMP_LT,
+    CMP_LE,
+    CMP_GT,
+    CMP_GE,
+  };
+
+  // the compare is part of the op so the common conditions like tick>=N are
+  // only one op to run
+  struct Op
+  {
+    OpType type;
+    Compare compare;
+    // the led to read
+    uint32_t arg;
+    // what it's compared with
+    uint32_t value;
+  };
+
+  // how many values can be on the stack at once
+  static const uint32_t MAX_STACK = 32;
+  // how deep the brackets and !s can go
+  static const uint32_t MAX_NESTING = 64;
+
+  // the parser, each one adds its ops and returns false on an error
+  bool parseOr();
+  bool parseAnd();
+  bool parseUnary();
+  bool parseCompare();
+  bool parseValue(const char *atom);
+  bool fail(const char *what);
+  void skipSpace();
+  bool accept(const char *token);
+  void emit(OpType type, uint32_t arg = 0);
+
+  std::vector<Op> m_ops;
+  std::string m_expr;
+  uint32_t m_numLeds;
+  // the frame before for frame_changed, only kept if it's used
+  RGBColor *m_lastLeds;
+  bool m_watchChanges;
+  bool m_haveLast;
+
+  // only used while compiling
+  const char *m_pos;
+  uint32_t m_depth;
+  uint32_t m_maxDepth;
+  uint32_t m_nesting;
+  std::string m_error;
+};
@@ -0,0 +1,75 @@
+#!/bin/bash
+
+# Times long --no-timestep runs of vortex in --null, --hex and --color mode, the
+# --null run is the engine by itself without any formatting or output. Pass a
+# second vortex binary with -b=<path> (for example one built from an older
+# commit) to compare the output path of the two side by side
+
+VORTEX="../vortex"
+BASELINE=
+RUNS=5
+INPUT="w100000q"
+
+for arg in "$@"
+do
+  if [[ $arg =~ ^-b=(.*)$ ]]; then
+    BASELINE="${BASH_REMATCH[1]}"
+  fi
+  if [[ $arg =~ ^-n=([0-9]*)$ ]]; then
+    RUNS="${BASH_REMATCH[1]}"
+  fi
+  if [[ $arg =~ ^-w=([0-9]*)$ ]]; then
+    INPUT="w${BASH_REMATCH[1]}q"
+  fi
+done
+
+# print the average milliseconds of RUNS runs of a binary with some args
+function time_runs() {
+  local binary=$1
+  local args=$2
+  local total=0
+  for i in $(seq 1 $RUNS); do
+    local start=$(date +%s%N)
+    $binary $args --no-timestep <<< $INPUT > /dev/null
+    local end=$(date +%s%N)
+    total=$((total + (end - start) / 1000000))
+  done
+  echo $((total / RUNS))
+}
+
+function bench() {
+  local name=$1
+  local args=$2
+  local nobaseline=$3
+  echo -e -n "\e[33m$name\e[0m: "
+  local cur=$(time_runs $VORTEX "$args")
+  echo -e -n "\e[97m${cur}ms\e[0m"
+  if [ "$BASELINE" != "" ] && [ "$nobaseline" == "" ]; then
+    local base=$(time_runs $BASELINE "$args")
+    echo -e -n " (baseline \e[97m${base}ms\e[0m)"
+  fi
+  echo ""
+}
+
+echo -e -n "\e[33mBuilding Vortex...\e[0m"
+make -C ../ &> /dev/null
+if [ $? -ne 0 ]; then
+  echo -e "\e[31mFailed to build Vortex!\e[0m"
+  exit 1
+fi
+if [ ! -x "$VORTEX" ]; then
+  echo -e "\e[31mCould not find Vortex!\e[0m"
+  exit 1
+fi
+if [ "$BASELINE" != "" ] && [ ! -x "$BASELINE" ]; then
+  echo -e "\e[31mCould not find baseline $BASELINE!\e[0m"
+  exit 1
+fi
+echo -e "\e[32mSuccess\e[0m"
+
+echo -e "\e[33m== [\e[97mBENCHMARK $INPUT x$RUNS\e[33m] ==\e[0m"
+# older binaries don't have --null
+bench "null" "--null" 1
+bench "hex" "--hex"
+bench "color" "--color"
+bench "headless hex" "--hex --until-input-exhausted" 1
@@ -0,0 +1,27 @@
+#include "BinaryFrames.h"
+
+// Decodes the --binary output on stdin with the BinaryFrameReader and prints
+// each frame like --hex does, with -t every line starts with the tick
+//
+//   ../vortex -t --binary <<< w100q | ./binary_frames
+
+int main(int argc, char *argv[])
+{
+  bool ticks = (argc > 1 && strcmp(argv[1], "-t") == 0);
+  BinaryFrameReader reader;
+  if (!reader.open(stdin)) {
+    fprintf(stderr, "Not a vortex binary frames stream\n");
+    return 1;
+  }
+  uint8_t rgb[BINARY_EVENT_END * 3];
+  while (reader.readFrame(rgb)) {
+    if (ticks) {
+      printf("%u ", reader.frameTick());
+    }
+    for (uint32_t i = 0; i < reader.numLeds() * 3; ++i) {
+      printf("%02X", rgb[i]);
+    }
+    printf("\n");
+  }
+  return 0;
+}
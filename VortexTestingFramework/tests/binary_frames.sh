@@ -0,0 +1,36 @@
+#!/bin/bash
+
+# Decodes the --binary output of every .test of a project in both formats with
+# the BinaryFrameReader and checks it against the frames of the golden, and
+# that a filtered run keeps the tick of each frame
+#
+#   ./binary_frames.sh [project...]    (default: core)
+
+source ./test_helpers.sh
+
+DECODE="./binary_frames"
+DEFAULT_PROJECTS=(core)
+
+find_projects "$@"
+begin_tests binary_frames $DECODE
+
+for FILE in $(for PROJECT in "${PROJECTS[@]}"; do ls $PROJECT/*.test; done); do
+  NAME="$(basename $FILE .test)"
+  INPUT="$(grep "Input=" $FILE | cut -d= -f2)"
+  ARGS="$(grep "Args=" $FILE | cut -d= -f2)"
+  DIVIDER=$(grep -n -- "--------------------------------------------------------------------------------" $FILE | cut -f1 -d:)
+  begin_case "Binary $(dirname $FILE)" "$NAME"
+  tail -n +$(($DIVIDER + 1)) $FILE > $TMP/$NAME.expected
+  RESULT=0
+  for FORMAT in frames events; do
+    $VORTEX $ARGS --no-timestep --binary=$FORMAT <<< $INPUT 2> /dev/null | $DECODE > $TMP/$NAME.output
+    diff --brief $TMP/$NAME.expected $TMP/$NAME.output &> /dev/null || RESULT=1
+  done
+  # every third frame along with the tick it was on
+  awk '(NR - 1) % 3 == 0 { print (NR - 1) " " $0 }' $TMP/$NAME.expected > $TMP/$NAME.every
+  $VORTEX $ARGS --no-timestep --binary --every 3 <<< $INPUT 2> /dev/null | $DECODE -t > $TMP/$NAME.output
+  diff --brief $TMP/$NAME.every $TMP/$NAME.output &> /dev/null || RESULT=1
+  end_case $RESULT
+done
+
+end_tests "ALL BINARY FRAMES PASSED"
@@ -1,7 +1,7 @@
 #!/bin/bash
 
 VORTEX="$(pwd)/../vortex"
-OUTPUT_FILE="recorded_input.txt"
+OUTPUT_FILE="recorded_input.ticks"
 
 # Color definitions
 RED="$(tput setaf 1)"
@@ -52,33 +52,6 @@ select_repo() {
   echo $repo
 }
 
-# a helper function to insert w10 and w100 between characters in the input string
-function insert_w10_w100() {
-  local input_string="$1"
-  local output_string=""
-  local length=${#input_string}
-  local last_index=$((length - 1))
-
-  for (( i=0; i<$length; i++ )); do
-      char=${input_string:$i:1}
-
-      if [[ $char =~ [0-9] ]]; then
-          output_string+="$char"
-      else
-          if [ $i -ne 0 ]; then
-              if [ $i -eq $last_index ]; then
-                  output_string+="w100"
-              else
-                  output_string+="w10"
-              fi
-          fi
-          output_string+="$char"
-      fi
-  done
-
-  echo "$output_string"
-}
-
 # select the target repo to create a test for
 TARGETREPO=$(select_repo)
 
@@ -112,7 +85,8 @@ while true; do
 
   if [ $INTERACTIVE -eq 1 ]; then
     # Run the Vortex program
-    $VORTEX $ARGS --color --in-place --record
+    rm -f "$OUTPUT_FILE"
+    $VORTEX $ARGS --color --in-place --record-ticks "$OUTPUT_FILE"
 
     # Check if the output file exists and read the result from it
     if [ ! -f "$OUTPUT_FILE" ]; then
@@ -120,7 +94,8 @@ while true; do
       exit
     fi
 
-    RESULT=$(cat "$OUTPUT_FILE")
+    # the waits between the inputs come from the ticks they were recorded on
+    RESULT=$($VORTEX --to-input "$OUTPUT_FILE")
     echo -n "${YELLOW}Use Result [${WHITE}$RESULT${YELLOW}]? (Y/n): ${WHITE}"
 
     read -e CONFIRM
@@ -128,7 +103,7 @@ while true; do
       exit
     fi
 
-    NEW_INPUT=$(insert_w10_w100 "$RESULT")
+    NEW_INPUT="$RESULT"
 
     echo -e "\n${WHITE}================================================================================${NC}"
     echo -e "Processed Input: ${WHITE}$NEW_INPUT${NC}"
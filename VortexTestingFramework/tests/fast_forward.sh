@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# Checks that --fast-forward predicts the long waits of a periodic pattern and
+# still gives exactly the same frames as ticking through them, the --stats
+# have to show that ticks really were predicted
+#
+#   ./fast_forward.sh
+
+source ./test_helpers.sh
+
+# each case is the args and the input, separated by a ;
+CASES=(
+  "-P0 -Cred,green;w20000q"
+  "-P0 -Cred,green,blue;w5000cw8000q"
+  "-P3 -Cred,blue;w3000lw10000cw10000q"
+  "-P12 -Cwhite,cyan,purple;w30000q"
+  "-P0 -Cred,green --repeat;w20000cw20000q"
+  "-P0 -Cred,green --frames 40000;w20000q"
+)
+
+begin_tests fast_forward
+
+NUM=0
+for CASE in "${CASES[@]}"; do
+  NUM=$((NUM + 1))
+  IFS=';' read -r ARGS INPUT <<< "$CASE"
+  begin_case "Fast-forward $NUM" "$ARGS"
+  $VORTEX $ARGS --no-timestep --hex --autowake <<< $INPUT &> $TMP/$NUM.expected
+  $VORTEX $ARGS --no-timestep --hex --autowake --fast-forward --stats <<< $INPUT 2> $TMP/$NUM.stats > $TMP/$NUM.output
+  # Fast-forward: <predicted> of <ticks> ticks predicted in <waits> waits
+  PREDICTED="$(grep "^Fast-forward:" $TMP/$NUM.stats | cut -d' ' -f2)"
+  RESULT=0
+  diff --brief $TMP/$NUM.expected $TMP/$NUM.output &> /dev/null || RESULT=1
+  [ "${PREDICTED:-0}" -gt 0 ] || RESULT=1
+  end_case $RESULT "${PREDICTED:-no} ticks predicted"
+done
+
+end_tests "ALL FAST-FORWARDS PASSED"
@@ -0,0 +1,61 @@
+#!/bin/bash
+
+# Checks that --input-file gives the same frames as the input on stdin, both
+# for a .test file where only its Input= line is read and for a plain file
+# of the commands, and for inputs that are fed to the engine over many chunks
+#
+#   ./input_file.sh [project...]    (default: every project)
+
+source ./test_helpers.sh
+
+find_projects "$@"
+begin_tests input_file
+
+# print a command n times
+function repeat() {
+  local i
+  for ((i = 0; i < $2; i++)); do
+    echo -n "$1"
+  done
+}
+
+# inputs that are many times the 4096 bytes the feed hands out at once and
+# the 1024 ticks it keeps ahead of the engine, with rapid clicks (rN takes N
+# ticks) and counts that can be split across the chunks
+LARGE=(
+  "clicks;$(repeat "cw7" 3000)q"
+  "rapid;$(repeat "r15w40" 1500)q"
+  "long waits;$(repeat "w300c" 1000)q"
+  "counts;$(repeat "w123r9w8" 1200)q"
+  "menus;$(repeat "mw200aw50cw400lw300" 300)q"
+  "presses;$(repeat "tw13tw29" 1000)q"
+)
+
+for CASE in "${LARGE[@]}"; do
+  IFS=';' read -r NAME INPUT <<< "$CASE"
+  begin_case "Input file" "$NAME, ${#INPUT} bytes"
+  echo "$INPUT" > $TMP/large.txt
+  $VORTEX --no-timestep --hex < $TMP/large.txt &> $TMP/large.expected
+  $VORTEX --no-timestep --hex --input-file $TMP/large.txt < /dev/null &> $TMP/large.output
+  diff --brief $TMP/large.expected $TMP/large.output &> /dev/null
+  end_case $?
+done
+
+for FILE in $(for PROJECT in "${PROJECTS[@]}"; do ls $PROJECT/*.test; done); do
+  NAME="$(basename $FILE .test)"
+  INPUT="$(grep "Input=" $FILE | cut -d= -f2)"
+  ARGS="$(grep "Args=" $FILE | cut -d= -f2)"
+  begin_case "Input file $(dirname $FILE)" "$NAME"
+  $VORTEX $ARGS --no-timestep --hex <<< $INPUT &> $TMP/$NAME.expected
+  # the .test file as it is
+  $VORTEX $ARGS --no-timestep --hex --input-file $FILE < /dev/null &> $TMP/$NAME.output
+  RESULT=0
+  diff --brief $TMP/$NAME.expected $TMP/$NAME.output &> /dev/null || RESULT=1
+  # and just the commands in a file of their own
+  echo "$INPUT" > $TMP/$NAME.txt
+  $VORTEX $ARGS --no-timestep --hex --input-file $TMP/$NAME.txt < /dev/null &> $TMP/$NAME.output
+  diff --brief $TMP/$NAME.expected $TMP/$NAME.output &> /dev/null || RESULT=1
+  end_case $RESULT
+done
+
+end_tests "ALL INPUT FILES PASSED"
@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# Converts between full frame output and the collapsed output of --repeat
+# where a run of identical frames is printed once as <frame>*<count>
+#
+#   ./repeat_frames.sh < full.txt > collapsed.txt
+#   ./repeat_frames.sh -d < collapsed.txt > full.txt
+
+DECODE=0
+
+for arg in "$@"
+do
+  if [ "$arg" == "-d" ]; then
+    DECODE=1
+  fi
+done
+
+if [ $DECODE -eq 1 ]; then
+  # expand each <frame>*<count> line back into count copies of the frame
+  awk '{
+    i = index($0, "*")
+    if (i == 0) {
+      print
+      next
+    }
+    frame = substr($0, 1, i - 1)
+    count = substr($0, i + 1) + 0
+    for (j = 0; j < count; j++) {
+      print frame
+    }
+  }'
+else
+  # collapse each run of identical lines into <frame>*<count>
+  awk '
+  function emit() {
+    if (count > 1) {
+      print prev "*" count
+    } else {
+      print prev
+    }
+  }
+  {
+    if (count > 0 && $0 == prev) {
+      count++
+      next
+    }
+    if (count > 0) {
+      emit()
+    }
+    prev = $0
+    count = 1
+  }
+  END {
+    if (count > 0) {
+      emit()
+    }
+  }'
+fi
@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# Records the input of every .test of a project with --record-ticks and checks
+# that a --replay of the recording, and the input --to-input makes out of it,
+# both give the same frames as the run that was recorded, then turns a few
+# hand written recordings with the input coming in over time into input
+#
+#   ./replay.sh [project...]    (default: core)
+
+source ./test_helpers.sh
+
+DEFAULT_PROJECTS=(core)
+
+# each case is a recording with the lines separated by a | and the input it
+# has to turn into, separated by a ;
+RECORDINGS=(
+  "0 c|120 l|480 m|2000 end;cw119lw359mw1519q"
+  "5 c|6 c|40 r3|300 t|310 t|900 q;w5ccw33r3w257tw9tw589q"
+  "0 c|50 w10c|51 c|3000 end;cw49w10ccw2938q"
+  "1 t|2 t|700 c|1500 end;wttw697cw799q"
+)
+
+find_projects "$@"
+begin_tests replay
+
+for FILE in $(for PROJECT in "${PROJECTS[@]}"; do ls $PROJECT/*.test; done); do
+  NAME="$(basename $FILE .test)"
+  INPUT="$(grep "Input=" $FILE | cut -d= -f2)"
+  ARGS="$(grep "Args=" $FILE | cut -d= -f2)"
+  begin_case "Replay $(dirname $FILE)" "$NAME"
+  $VORTEX $ARGS --no-timestep --hex --record-ticks $TMP/$NAME.ticks <<< $INPUT 2> /dev/null > $TMP/$NAME.expected
+  $VORTEX $ARGS --no-timestep --hex --replay $TMP/$NAME.ticks < /dev/null 2> /dev/null > $TMP/$NAME.output
+  RESULT=0
+  diff --brief $TMP/$NAME.expected $TMP/$NAME.output &> /dev/null || RESULT=1
+  # the recording turned back into plain input
+  $VORTEX --to-input $TMP/$NAME.ticks > $TMP/$NAME.input 2> /dev/null || RESULT=1
+  $VORTEX $ARGS --no-timestep --hex < $TMP/$NAME.input 2> /dev/null > $TMP/$NAME.output
+  diff --brief $TMP/$NAME.expected $TMP/$NAME.output &> /dev/null || RESULT=1
+  end_case $RESULT
+done
+
+NUM=0
+for CASE in "${RECORDINGS[@]}"; do
+  NUM=$((NUM + 1))
+  IFS=';' read -r LINES INPUT <<< "$CASE"
+  begin_case "Recording $NUM" "$INPUT"
+  echo "# vortex input recording" > $TMP/$NUM.ticks
+  tr '|' '\n' <<< $LINES >> $TMP/$NUM.ticks
+  RESULT=0
+  [ "$($VORTEX --to-input $TMP/$NUM.ticks 2> /dev/null)" == "$INPUT" ] || RESULT=1
+  # the replay has to wait for each line just like the waits in the input
+  $VORTEX --no-timestep --hex <<< $INPUT 2> /dev/null > $TMP/$NUM.expected
+  $VORTEX --no-timestep --hex --replay $TMP/$NUM.ticks < /dev/null 2> /dev/null > $TMP/$NUM.output
+  diff --brief $TMP/$NUM.expected $TMP/$NUM.output &> /dev/null || RESULT=1
+  end_case $RESULT
+done
+
+end_tests "ALL REPLAYS PASSED"
@@ -8,6 +8,7 @@ DIFF="diff"
 TARGETREPO=
 VERBOSE=0
 AUDIT=0
+COLLAPSE=0
 TODO=
 
 REPOS=(
@@ -33,6 +34,9 @@ do
     VERBOSE=1
     VALGRIND=
   fi
+  if [ "$arg" == "-c" ]; then
+    COLLAPSE=1
+  fi
   if [[ $arg =~ ^-t=([0-9]*)$ ]]; then
     TODO="${BASH_REMATCH[1]}"
   fi
@@ -115,7 +119,12 @@ function run_tests() {
     EXPECTED="tmp/${FILE}.expected"
     OUTPUT="tmp/${FILE}.output"
     DIFFOUT="tmp/${FILE}.diff"
-    tail -n +$(($DIVIDER + 1)) "$FILE" &> $EXPECTED
+    if [ $COLLAPSE -eq 1 ]; then
+      # compare the collapsed forms so repeated frames are only diffed once
+      tail -n +$(($DIVIDER + 1)) "$FILE" | ./repeat_frames.sh &> $EXPECTED
+    else
+      tail -n +$(($DIVIDER + 1)) "$FILE" &> $EXPECTED
+    fi
     # run again?
     if [ $AUDIT -eq 1 ]; then
       echo -n "${YELLOW}Begin test? (Y/n): ${WHITE}"
@@ -131,7 +140,11 @@ function run_tests() {
       echo "Test: $TESTNUM"
       echo "-----------------------------"
     fi
-    $VALGRIND $VORTEX $ARGS --no-timestep --hex <<< $INPUT &> $OUTPUT
+    if [ $COLLAPSE -eq 1 ]; then
+      $VALGRIND $VORTEX $ARGS --no-timestep --hex --repeat <<< $INPUT &> $OUTPUT
+    else
+      $VALGRIND $VORTEX $ARGS --no-timestep --hex <<< $INPUT &> $OUTPUT
+    fi
     $DIFF --brief $EXPECTED $OUTPUT &> $DIFFOUT
     RESULT=$?
     if [ $VERBOSE -eq 1 ]; then
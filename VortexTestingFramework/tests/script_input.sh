@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# Checks that the loops and macros of an input script for --script play back
+# exactly the same frames as the plain input commands they stand for
+#
+#   ./script_input.sh
+
+source ./test_helpers.sh
+
+# each case is a script and the plain input it expands to, separated by a |
+CASES=(
+  "c w10 c w10 q|cw10cw10q"
+  "(c w10)x3 q|cw10cw10cw10q"
+  "((c w2)x2 l w5)x2 q|cw2cw2lw5cw2cw2lw5q"
+  "(w100)x1 m w20 q|w100mw20q"
+  "@open { m w50 }   @open a w20 q|mw50aw20q"
+  "@click { c w5 }   @twice { @click @click }   @twice (@twice)x2 q|cw5cw5cw5cw5cw5cw5q"
+  "# a comment   c w10 # and another   q|cw10q"
+)
+
+begin_tests script_input
+
+NUM=0
+for CASE in "${CASES[@]}"; do
+  NUM=$((NUM + 1))
+  # the spaces in a case are newlines in the script
+  SCRIPT="$(echo "${CASE%%|*}" | sed 's/   /\n/g')"
+  INPUT="${CASE##*|}"
+  echo "$SCRIPT" > $TMP/$NUM.script
+  begin_case "Script $NUM" "${CASE%%|*}"
+  $VORTEX --no-timestep --hex <<< $INPUT &> $TMP/$NUM.expected
+  $VORTEX --no-timestep --hex --script $TMP/$NUM.script < /dev/null &> $TMP/$NUM.output
+  diff --brief $TMP/$NUM.expected $TMP/$NUM.output &> /dev/null
+  end_case $?
+done
+
+end_tests "ALL SCRIPTS PASSED"
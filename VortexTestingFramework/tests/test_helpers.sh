@@ -0,0 +1,81 @@
+#!/bin/bash
+
+# The scaffold shared by the checks that compare vortex against itself, they
+# source this from the tests directory:
+#
+#   source ./test_helpers.sh
+#   find_projects "$@"                      (only the checks that read .test files)
+#   begin_tests <name> [other executables]
+#   begin_case <label> <detail>
+#   end_case <result> [note]                (a result of 0 is a success)
+#   end_tests <what passed>
+
+VORTEX="../vortex"
+ALLSUCCESS=1
+
+# the projects named on the command line, otherwise the DEFAULT_PROJECTS or
+# every one that has tests
+function find_projects() {
+  local arg
+  PROJECTS=()
+  for arg in "$@"; do
+    if [ -d "$arg" ]; then
+      PROJECTS+=("$arg")
+    fi
+  done
+  if [ ${#PROJECTS[@]} -ne 0 ]; then
+    return
+  fi
+  if [ ${#DEFAULT_PROJECTS[@]} -ne 0 ]; then
+    PROJECTS=("${DEFAULT_PROJECTS[@]}")
+    return
+  fi
+  for arg in core gloves orbit handle duo duo_basicpattern; do
+    if [ -d "$arg" ]; then
+      PROJECTS+=("$arg")
+    fi
+  done
+}
+
+# check that vortex and whatever else is run was built, and make the tmp
+# folder for the outputs
+function begin_tests() {
+  local exe
+  TMP="tmp/$1"
+  shift
+  for exe in "$VORTEX" "$@"; do
+    if [ ! -x "$exe" ]; then
+      echo -e "\e[31mCould not find $exe, build it with make tests\e[0m"
+      exit 1
+    fi
+  done
+  mkdir -p $TMP
+}
+
+function begin_case() {
+  echo -e -n "\e[33m$1 [\e[97m$2\e[33m] ... \e[0m"
+}
+
+function end_case() {
+  local note=""
+  if [ -n "$2" ]; then
+    note=" ($2)"
+  fi
+  if [ $1 -eq 0 ]; then
+    echo -e "\e[32mSUCCESS\e[0m$note"
+  else
+    echo -e "\e[31mFAILURE\e[0m$note"
+    ALLSUCCESS=0
+  fi
+}
+
+# the tmp folder is only kept around when something failed
+function end_tests() {
+  if [ $ALLSUCCESS -eq 1 ]; then
+    echo -e "\e[33m== [\e[32mSUCCESS $1\e[33m] ==\e[0m"
+    rm -rf $TMP
+  else
+    echo -e "\e[31m== FAILURE ==\e[0m"
+    exit 1
+  fi
+}
@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# Checks the exit code of --until runs and that they stop on the right tick,
+# the frames of each case have to be the first of the same run without it
+#
+#   ./until.sh
+
+source ./test_helpers.sh
+
+# each case is the args, the input, the exit code and how many of the frames
+# it keeps (all for every frame, none for no frames at all), separated by a ;
+CASES=(
+  "--until tick>=50;w200q;0;51"
+  "--until tick==0;w200q;0;1"
+  "--until tick>=500;w100q;1;all"
+  "--until tick>=1000 --until-max 100;w2000q;1;100"
+  "--until !sleeping&&tick>=20;w200q;0;21"
+  "--until tick>=50||menu==randomizer;w200q;0;51"
+  "--until tick>=50 --until-action dump;w200q;0;all"
+  "--until led[0]==;w200q;1;none"
+  "--until tick>=;w200q;1;none"
+  "--until bogus;w200q;1;none"
+  "--until tick>=50 --until-action bogus;w200q;1;none"
+)
+
+begin_tests until
+
+NUM=0
+for CASE in "${CASES[@]}"; do
+  NUM=$((NUM + 1))
+  IFS=';' read -r ARGS INPUT CODE FRAMES <<< "$CASE"
+  begin_case "Until $NUM" "$ARGS"
+  $VORTEX --no-timestep --hex <<< $INPUT 2> /dev/null > $TMP/$NUM.full
+  $VORTEX $ARGS --no-timestep --hex <<< $INPUT 2> /dev/null > $TMP/$NUM.output
+  RESULT=$?
+  case $FRAMES in
+    all) cp $TMP/$NUM.full $TMP/$NUM.expected ;;
+    # only the error, anything that looks like a frame is a failure
+    none) grep -E -v '^[0-9A-F]+$' $TMP/$NUM.output > $TMP/$NUM.expected ;;
+    *) head -n $FRAMES $TMP/$NUM.full > $TMP/$NUM.expected ;;
+  esac
+  CHECK=0
+  [ $RESULT -eq $CODE ] || CHECK=1
+  diff --brief $TMP/$NUM.expected $TMP/$NUM.output &> /dev/null || CHECK=1
+  end_case $CHECK "exit code $RESULT"
+done
+
+end_tests "ALL UNTIL CHECKS PASSED"